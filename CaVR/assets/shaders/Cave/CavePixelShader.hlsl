@@ -30,6 +30,8 @@ struct Light {
   float2 _padding;
 
   matrix lightTransform;
+
+  float4 shadowRect;
 };
 
 cbuffer Lights : register(b0) { Light lights[MAX_LIGHTS]; }
@@ -3,6 +3,7 @@
 //
 
 #include "cavr/CavrEngine.h"
+#include <iomanip>
 #include "dg/Graphics.h"
 #include "dg/Scene.h"
 #include "dg/Window.h"
@@ -18,12 +19,15 @@ void cavr::CavrEngine::UpdateWindowTitle() {
   }
 
   if (scene->AutomaticWindowTitle()) {
+    dg::Time::FrameStatistics stats = dg::Time::GetFrameStatistics();
     window->SetTitle(
         ((std::ostringstream &)(std::ostringstream()
                                 << "CaVR | " << dg::Graphics::GetAPIName()
-                                << " | " << (int)(1.0 / dg::Time::Delta)
+                                << " | " << (int)(1.0 / dg::Time::FrameDelta)
                                 << " FPS | " << dg::Time::AverageFrameRate
-                                << " average FPS"))
+                                << " average FPS | " << std::setprecision(3)
+                                << stats.p99 * 1000 << " ms p99 | "
+                                << stats.max * 1000 << " ms max"))
             .str());
   }
   lastWindowUpdateTime = dg::Time::Elapsed;
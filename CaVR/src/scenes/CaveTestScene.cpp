@@ -393,8 +393,9 @@ void cavr::CaveTestScene::Update() {
   Scene::Update();
 
   // Get VR controller states.
-  auto leftState = leftController->GetBehavior<dg::VRControllerState>();
-  auto rightState = rightController->GetBehavior<dg::VRControllerState>();
+  auto leftState = leftController->GetBehaviorPointer<dg::VRControllerState>();
+  auto rightState =
+      rightController->GetBehaviorPointer<dg::VRControllerState>();
 
   // Toggle outer material type with left MENU button.
   if (leftState->IsButtonJustPressed(dg::VRControllerState::Button::MENU)) {
@@ -205,9 +205,10 @@ void cavr::GameScene::ResetGame() {
 
 void cavr::GameScene::Update() {
   Scene::Update();
-  auto leftState = leftController->GetBehavior<dg::VRControllerState>();
-  auto rightState = rightController->GetBehavior<dg::VRControllerState>();
-  auto caveBehavior = cave->GetBehavior<CaveBehavior>();
+  auto leftState = leftController->GetBehaviorPointer<dg::VRControllerState>();
+  auto rightState =
+      rightController->GetBehaviorPointer<dg::VRControllerState>();
+  auto caveBehavior = cave->GetBehaviorPointer<CaveBehavior>();
 
   // Swap left and right controllers with TILDE key.
   if (window->IsKeyJustPressed(dg::Key::GRAVE_ACCENT)) {
@@ -318,8 +319,10 @@ void cavr::GameScene::Update() {
       if (ship->IntersectsCave() && devModeState != DevModeState::Enabled) {
         gameState = GameState::Starting;
         if (vr.enabled) {
-          leftController->GetBehavior<dg::VRTrackedObject>()->TriggerHaptic(2);
-          rightController->GetBehavior<dg::VRTrackedObject>()->TriggerHaptic(2);
+          leftController->GetBehaviorPointer<dg::VRTrackedObject>()
+              ->TriggerHaptic(2);
+          rightController->GetBehaviorPointer<dg::VRTrackedObject>()
+              ->TriggerHaptic(2);
         }
       }
       break;
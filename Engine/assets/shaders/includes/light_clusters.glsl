@@ -0,0 +1,82 @@
+// Lights assigned to clusters of the view by dg::LightClusters.
+//
+// Global lights, such as directional lights, come first in _LightData and
+// apply everywhere. Every other light is listed in the clusters it reaches:
+// _LightGrid holds each cluster's (offset, count) into _LightIndices, which
+// holds indices into _LightData.
+//
+// NOTE: Keep this consistent with include/dg/LightClusters.h.
+
+struct LightClusterGrid {
+  // Clusters across, up, and in depth. Zero if there are no clusters.
+  int tilesX;
+  int tilesY;
+  int slices;
+
+  // Slice of a view-space depth d is log(d) * depthScale + depthBias.
+  float depthScale;
+  float depthBias;
+
+  int globalLights;
+};
+
+uniform LightClusterGrid _LightClusters;
+uniform samplerBuffer _LightData;
+uniform usamplerBuffer _LightGrid;
+uniform usamplerBuffer _LightIndices;
+
+const int LIGHT_DATA_TEXELS = 11;
+
+Light fetchLight(int index) {
+  int texel = index * LIGHT_DATA_TEXELS;
+  vec4 diffuse = texelFetch(_LightData, texel);
+  vec4 ambient = texelFetch(_LightData, texel + 1);
+  vec4 specular = texelFetch(_LightData, texel + 2);
+  vec4 position = texelFetch(_LightData, texel + 3);
+  vec4 direction = texelFetch(_LightData, texel + 4);
+  vec4 extra = texelFetch(_LightData, texel + 5);
+
+  Light light;
+  light.type = int(diffuse.w);
+  light.diffuse = diffuse.xyz;
+  light.ambient = ambient.xyz;
+  light.innerCutoff = ambient.w;
+  light.specular = specular.xyz;
+  light.outerCutoff = specular.w;
+  light.position = position.xyz;
+  light.constantCoeff = position.w;
+  light.direction = direction.xyz;
+  light.linearCoeff = direction.w;
+  light.quadraticCoeff = extra.x;
+  light.hasShadow = int(extra.y);
+  light.lightTransform = mat4(
+      texelFetch(_LightData, texel + 6), texelFetch(_LightData, texel + 7),
+      texelFetch(_LightData, texel + 8), texelFetch(_LightData, texel + 9));
+  light.shadowRect = texelFetch(_LightData, texel + 10);
+  return light;
+}
+
+// Returns the (offset, count) of the lights in _LightIndices for the
+// cluster containing scenePos.
+uvec2 lightCluster(vec4 scenePos) {
+  if (_LightClusters.tilesX == 0) {
+    return uvec2(0);
+  }
+
+  vec4 viewPos = _Matrix_V * scenePos;
+  vec4 clipPos = _Matrix_P * viewPos;
+  vec2 tiles = vec2(_LightClusters.tilesX, _LightClusters.tilesY);
+  ivec2 tile = ivec2(clamp((clipPos.xy / clipPos.w * 0.5 + 0.5) * tiles,
+                           vec2(0), tiles - 1));
+  int slice = clamp(
+      int(log(max(-viewPos.z, 1e-6)) * _LightClusters.depthScale +
+          _LightClusters.depthBias),
+      0, _LightClusters.slices - 1);
+  int cluster =
+      (slice * _LightClusters.tilesY + tile.y) * _LightClusters.tilesX + tile.x;
+  return texelFetch(_LightGrid, cluster).rg;
+}
+
+int clusterLightIndex(uvec2 cluster, uint i) {
+  return int(texelFetch(_LightIndices, int(cluster.x + i)).r);
+}
@@ -0,0 +1,40 @@
+// Cascaded shadow maps of the directional light whose hasShadow is
+// SHADOW_CASCADES, bound by Material::SendShadowCascades().
+
+// NOTE: Keep this consistent with ShadowCascades::MaxCascades.
+const int MAX_SHADOW_CASCADES = 4;
+
+struct ShadowCascades {
+  int count;
+  // Distance in front of the camera at which each cascade ends.
+  vec4 splits;
+  mat4 transforms[MAX_SHADOW_CASCADES];
+};
+
+uniform ShadowCascades _ShadowCascades;
+uniform sampler2DArray _ShadowCascadeMap;
+
+// 1 if a scene-space position is in the cascaded light's shadow, else 0.
+// Positions beyond the last cascade are unshadowed.
+float cascadedShadow(vec4 scenePos) {
+  float depth = -(_Matrix_V * scenePos).z;
+  int cascade = 0;
+  while (cascade < _ShadowCascades.count &&
+         depth > _ShadowCascades.splits[cascade]) {
+    cascade++;
+  }
+  if (cascade == _ShadowCascades.count) {
+    return 0.0;
+  }
+
+  vec4 lightSpacePos = _ShadowCascades.transforms[cascade] * scenePos;
+  vec3 projCoords = lightSpacePos.xyz / lightSpacePos.w * 0.5 + 0.5;
+  if (any(lessThan(projCoords, vec3(0))) ||
+      any(greaterThan(projCoords, vec3(1)))) {
+    return 0.0;
+  }
+  float closestDepth =
+      texture(_ShadowCascadeMap, vec3(projCoords.xy, cascade)).r;
+  float bias = 0.0005;
+  return projCoords.z - bias > closestDepth ? 1.0 : 0.0;
+}
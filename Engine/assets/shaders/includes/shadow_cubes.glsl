@@ -0,0 +1,36 @@
+// Shadow cubes of the point lights whose hasShadow is SHADOW_CUBE, bound by
+// Material::SendShadowCubes().
+
+// NOTE: Keep this consistent with Light::MAX_SHADOW_CUBES.
+const int MAX_SHADOW_CUBES = 4;
+
+uniform samplerCube _ShadowCubes[MAX_SHADOW_CUBES];
+
+// 1 if a scene-space position is in a point light's shadow, else 0.
+float cubeShadow(Light light, vec4 scenePos) {
+  // A cube face's depth is the distance along its axis, which is whichever
+  // axis the direction from the light is longest along.
+  vec3 lightToFrag = scenePos.xyz - light.position;
+  vec3 distances = abs(lightToFrag);
+  float axisDistance = max(distances.x, max(distances.y, distances.z));
+  vec4 clipPos = light.lightTransform * vec4(0, 0, -axisDistance, 1);
+  float currentDepth = clipPos.z / clipPos.w * 0.5 + 0.5;
+  if (currentDepth > 1.0) {
+    return 0.0;
+  }
+
+  // Arrays of samplers can only be indexed by constants.
+  float closestDepth = 1.0;
+  int index = int(light.shadowRect.x);
+  if (index == 0) {
+    closestDepth = textureLod(_ShadowCubes[0], lightToFrag, 0).r;
+  } else if (index == 1) {
+    closestDepth = textureLod(_ShadowCubes[1], lightToFrag, 0).r;
+  } else if (index == 2) {
+    closestDepth = textureLod(_ShadowCubes[2], lightToFrag, 0).r;
+  } else if (index == 3) {
+    closestDepth = textureLod(_ShadowCubes[3], lightToFrag, 0).r;
+  }
+  float bias = 0.0005;
+  return currentDepth - bias > closestDepth ? 1.0 : 0.0;
+}
@@ -5,6 +5,12 @@
 #define LIGHT_TYPE_SPOT        2
 #define LIGHT_TYPE_DIRECTIONAL 3
 
+// Values of Light::hasShadow, where a light's shadow is found.
+#define SHADOW_NONE     0
+#define SHADOW_ATLAS    1
+#define SHADOW_CASCADES 2
+#define SHADOW_CUBE     3
+
 struct Light {
   // Type of light. Allowed values are those defined above.
 	int type;
@@ -29,9 +35,11 @@ struct Light {
   float linearCoeff;
   float quadraticCoeff;
 
-  // Shadow.
+  // Shadow. Allowed values of hasShadow are those defined above.
   int hasShadow;
   mat4 lightTransform;
+  // Region of _ShadowMap holding this light's shadow, as (offset, scale).
+  vec4 shadowRect;
 };
 
 uniform vec2 _BufferDimensions;
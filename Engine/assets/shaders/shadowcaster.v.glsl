@@ -0,0 +1,10 @@
+#version 330 core
+#include "includes/shared_head.glsl"
+#include "includes/vertex_head.glsl"
+#include "includes/vertex_main.glsl"
+
+// Shadow casters are projected by the geometry shader, once for each shadow
+// map they're drawn into, so this only passes on their scene position.
+vec4 vert() {
+  return v_ScenePos;
+}
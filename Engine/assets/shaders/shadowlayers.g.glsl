@@ -0,0 +1,51 @@
+#version 330 core
+
+// Draws each triangle into every layer of a layered shadow map that its
+// model can cast a shadow into, such as the layers of shadow cascades or
+// the faces of a shadow cube. See Scene::DrawLayeredShadowCasters().
+
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 18) out;
+
+// NOTE: Keep this consistent with Scene::MaxShadowLayers.
+const int MAX_LAYERS = 6;
+
+uniform mat4 _LayerTransforms[MAX_LAYERS];
+uniform int _LayerCount;
+// Bit i is set if the model being drawn reaches layer i.
+uniform int _LayerMask;
+
+in vec4 v_ScenePos[];
+
+void main() {
+  for (int layer = 0; layer < _LayerCount; layer++) {
+    if ((_LayerMask & (1 << layer)) == 0) {
+      continue;
+    }
+
+    vec4 positions[3];
+    for (int i = 0; i < 3; i++) {
+      positions[i] = _LayerTransforms[layer] * v_ScenePos[i];
+    }
+
+    // Skip triangles entirely off one side of the layer's view. Depth
+    // isn't tested, since casters are clipped by the near and far planes
+    // anyway.
+    bvec4 outside = bvec4(true);
+    for (int i = 0; i < 3; i++) {
+      vec4 p = positions[i];
+      outside = bvec4(outside.x && p.x < -p.w, outside.y && p.x > p.w,
+                      outside.z && p.y < -p.w, outside.w && p.y > p.w);
+    }
+    if (any(outside)) {
+      continue;
+    }
+
+    for (int i = 0; i < 3; i++) {
+      gl_Layer = layer;
+      gl_Position = positions[i];
+      EmitVertex();
+    }
+    EndPrimitive();
+  }
+}
@@ -1,6 +1,9 @@
 #version 330 core
 #include "includes/shared_head.glsl"
 #include "includes/fragment_head.glsl"
+#include "includes/light_clusters.glsl"
+#include "includes/shadow_cascades.glsl"
+#include "includes/shadow_cubes.glsl"
 #include "includes/fragment_main.glsl"
 
 struct Material {
@@ -76,50 +79,80 @@ vec3 calculateLight(
 
   // Calculate shadow
   float shadow = 0;
-  if (light.hasShadow == 1) {
+  if (light.hasShadow == SHADOW_ATLAS) {
     vec4 fragPosLightSpace = light.lightTransform * v_ScenePos;
     vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
     projCoords = projCoords * 0.5 + 0.5;
-    float closestDepth = texture(_ShadowMap, projCoords.xy).r;
-    float currentDepth = projCoords.z;
-    float bias = 0.0001;
-    shadow = currentDepth - bias > closestDepth  ? 1.0 : 0.0;
+
+    // The light's shadow is one tile of a shared shadow atlas. Fragments
+    // outside of the light's view are unshadowed, and samples are kept half
+    // a texel inside the tile so as not to filter in its neighbors.
+    if (all(greaterThanEqual(projCoords, vec3(0))) &&
+        all(lessThanEqual(projCoords, vec3(1)))) {
+      vec2 halfTexel = 0.5 / vec2(textureSize(_ShadowMap, 0));
+      vec2 atlasCoords = clamp(
+          light.shadowRect.xy + projCoords.xy * light.shadowRect.zw,
+          light.shadowRect.xy + halfTexel,
+          light.shadowRect.xy + light.shadowRect.zw - halfTexel);
+      float closestDepth = texture(_ShadowMap, atlasCoords).r;
+      float currentDepth = projCoords.z;
+      float bias = 0.0001;
+      shadow = currentDepth - bias > closestDepth  ? 1.0 : 0.0;
+    }
+  } else if (light.hasShadow == SHADOW_CASCADES) {
+    shadow = cascadedShadow(v_ScenePos);
+  } else if (light.hasShadow == SHADOW_CUBE) {
+    shadow = cubeShadow(light, v_ScenePos);
   }
 
 	return ((1.0 - shadow) * (specular + diffuse)) + ambient;
 }
 
+// Variant keywords, defined by StandardMaterial:
+//   LIT           Apply lighting.
+//   DIFFUSE_MAP   Sample _Material.diffuseMap instead of _Material.diffuse.
+//   SPECULAR_MAP  Sample _Material.specularMap instead of _Material.specular.
+//   NORMAL_MAP    Perturb normals with _Material.normalMap.
 vec4 frag() {
   vec2 texCoord = v_TexCoord * _UVScale;
 
-  vec4 diffuseColor = _Material.useDiffuseMap
-                    ? texture(_Material.diffuseMap, texCoord)
-                    : vec4(_Material.diffuse);
+#ifdef DIFFUSE_MAP
+  vec4 diffuseColor = texture(_Material.diffuseMap, texCoord);
+#else
+  vec4 diffuseColor = vec4(_Material.diffuse);
+#endif
 
-  if (!_Material.lit) {
-    return diffuseColor;
-  }
+#ifndef LIT
+  return diffuseColor;
+#else
 
-  vec3 specularColor = _Material.useSpecularMap
-                     ? texture(_Material.specularMap, texCoord).rgb
-                     : vec3(_Material.specular);
+#ifdef SPECULAR_MAP
+  vec3 specularColor = texture(_Material.specularMap, texCoord).rgb;
+#else
+  vec3 specularColor = vec3(_Material.specular);
+#endif
 
   vec3 normal = v_Normal;
-  if (_Material.useNormalMap) {
-    normal = normalize(texture(_Material.normalMap, texCoord).rgb * 2.0 - 1.0);
+#ifdef NORMAL_MAP
+  normal = normalize(texture(_Material.normalMap, texCoord).rgb * 2.0 - 1.0);
 
-    // Transform normal from tangent space (which is what the normal map is)
-    // to world space by left-multiplying the world-space basis vectors of
-    // this fragment's tangent space.
-    normal = normalize(v_TBN * normal);
-  }
+  // Transform normal from tangent space (which is what the normal map is)
+  // to world space by left-multiplying the world-space basis vectors of
+  // this fragment's tangent space.
+  normal = normalize(v_TBN * normal);
+#endif
 
   vec3 cumulative = vec3(0);
-  for (int i = 0; i < MAX_LIGHTS; i++) {
+  for (int i = 0; i < _LightClusters.globalLights; i++) {
     cumulative += calculateLight(
-        _Lights[i], normal, diffuseColor.rgb, specularColor);
+        fetchLight(i), normal, diffuseColor.rgb, specularColor);
+  }
+  uvec2 cluster = lightCluster(v_ScenePos);
+  for (uint i = 0u; i < cluster.y; i++) {
+    cumulative += calculateLight(fetchLight(clusterLightIndex(cluster, i)),
+                                 normal, diffuseColor.rgb, specularColor);
   }
 
   return vec4(cumulative, diffuseColor.a);
+#endif
 }
-
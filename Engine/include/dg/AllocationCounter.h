@@ -0,0 +1,39 @@
+//
+//  AllocationCounter.h
+//
+
+#pragma once
+
+#include <cstdint>
+
+namespace dg {
+
+  // Counts global heap allocations, so that it can be verified that code
+  // such as the steady-state render loop doesn't allocate:
+  //
+  //   uint64_t before = AllocationCounter::Count();
+  //   scene->RenderFrame();
+  //   assert(AllocationCounter::Count() == before);
+  //
+  // The engine uses it this way to report the first frame of each scene
+  // that allocates while rendering.
+  //
+  // Counting replaces the global operator new, and is only compiled in if
+  // DG_COUNT_ALLOCATIONS is defined (the COUNT_ALLOCATIONS CMake option).
+  // Since the replacement lives in the Engine library, it only applies
+  // process-wide on platforms where shared libraries can replace operator
+  // new, which excludes Windows DLLs. Over-aligned allocations aren't
+  // counted.
+  class AllocationCounter {
+
+    public:
+
+      static bool IsEnabled();
+
+      // Number of allocations since the process started. Always 0 if
+      // counting isn't enabled.
+      static uint64_t Count();
+
+  }; // class AllocationCounter
+
+} // namespace dg
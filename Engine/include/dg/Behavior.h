@@ -4,7 +4,10 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace dg {
 
@@ -14,15 +17,55 @@ namespace dg {
 
     public:
 
+      // Identifies a Behavior class without RTTI. Each class gets a unique
+      // address.
+      typedef const void *TypeID;
+
+      template <typename T>
+      static inline TypeID GetTypeID() {
+        static const char id = 0;
+        return &id;
+      }
+
       // Attach a behavior to a scene object. This initializes the behavior.
       // It returns the behavior being attached as its own type for
-      // convenience.
+      // convenience. The behavior is registered under that type, so that
+      // SceneObject::GetBehavior() can find it without casting.
       template <typename T>
       static inline T Attach(std::shared_ptr<SceneObject> object, T behavior) {
-        Attach_Impl(object, behavior);
+        Attach_Impl(object, behavior,
+                    GetTypeID<typename T::element_type>());
         return behavior;
       }
 
+      // What a behavior's Update() touches, which decides when and on which
+      // thread it runs. See GetUpdateAccess().
+      struct UpdateAccess {
+        // Whether Update() may run on a worker thread, concurrently with
+        // other behaviors' updates. Otherwise it runs after all parallel
+        // updates, on the thread updating the scene, and may do anything
+        // the scene allows. That's the main thread unless the scene is
+        // pipelined; see Scene::AllowsPipelinedUpdate().
+        bool parallel = false;
+
+        // Writes the local transform of the behavior's SceneObject.
+        bool writesTransform = false;
+
+        // Reads the transforms of other SceneObjects, including through
+        // SceneSpace().
+        bool readsTransforms = false;
+      };
+
+      // Queues a change to be applied on the main thread once the current
+      // batch of updates has finished. Parallel updates must use this for
+      // anything beyond their declared access, such as adding or removing
+      // children, enabling objects, or attaching behaviors. Commands queued
+      // by the same behavior run in the order they were queued.
+      static void Defer(std::function<void()> command);
+
+      // Runs all deferred commands. Called by the Scene.
+      static void RunDeferred();
+
       Behavior() = default;
       virtual ~Behavior() = default;
 
@@ -38,6 +81,19 @@ namespace dg {
       // Called every frame, only if it's enabled.
       virtual void Update();
 
+      // Declares what Update() touches. Behaviors are updated on the main
+      // thread unless they override this.
+      //
+      // Parallel behaviors that don't read other objects' transforms run
+      // first, with the behaviors of each object running in order on the
+      // same thread. Then, parallel behaviors that read other transforms
+      // but don't write their own run, seeing the first batch's writes.
+      // Parallel behaviors that both read and write transforms run after
+      // that, one at a time.
+      virtual UpdateAccess GetUpdateAccess() const {
+        return UpdateAccess();
+      }
+
       // Gets the SceneObject the behavior is attached to.
       std::shared_ptr<SceneObject> GetSceneObject() const;
 
@@ -48,7 +104,7 @@ namespace dg {
 
       static void Attach_Impl(
           std::shared_ptr<SceneObject> object,
-          std::shared_ptr<Behavior> behavior);
+          std::shared_ptr<Behavior> behavior, TypeID type);
 
       // The SceneObject the behavior is attached to.
       std::weak_ptr<dg::SceneObject> sceneObject;
@@ -58,6 +114,9 @@ namespace dg {
       // Whether Start() has been called on the behavior yet.
       bool started = false;
 
+      static std::mutex deferredMutex;
+      static std::vector<std::function<void()>> deferredCommands;
+
   }; // class Behavior
 
 } // namespace dg
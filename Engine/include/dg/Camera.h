@@ -35,6 +35,12 @@ namespace dg {
       glm::mat4x4 GetProjectionMatrix() const;
       glm::mat4x4 GetProjectionMatrix(vr::EVREye eye) const;
 
+      // Bounds the part of the camera's view between two distances in front
+      // of it by a sphere. The radius only depends on the distances and the
+      // projection, not on where the camera is or which way it faces.
+      void BoundView(float nearDistance, float farDistance, glm::vec3 &center,
+                     float &radius) const;
+
   }; // class Camera
 
 } // namespace dg
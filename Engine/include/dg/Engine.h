@@ -24,6 +24,8 @@
 #pragma comment(lib, "runtimeobject.lib")
 #endif
 
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <map>
@@ -85,9 +87,24 @@ namespace dg {
       std::shared_ptr<Scene> nextScene = nullptr;
       bool cursorWasLocked = false;
       double lastWindowUpdateTime = 0;
+      // Whether the current scene updates on a job while the previous frame
+      // renders. See Scene::AllowsPipelinedUpdate().
+      bool pipelined = false;
+      // How long the last frame's update and render took. When pipelined,
+      // they overlap, so a frame takes about as long as the slower of them.
+      std::chrono::duration<double> updateTime{0};
+      std::chrono::duration<double> renderTime{0};
+      // Frames the current scene has rendered, and whether one of them has
+      // been reported for allocating. See CheckFrameAllocations().
+      uint64_t sceneFrames = 0;
+      bool reportedFrameAllocations = false;
 
       void StartNextScene();
       void FixCurrentDirectory();
+      // Reports the first frame of a scene that made heap allocations while
+      // rendering, once the scene has had a few frames to warm up. Only
+      // checked if AllocationCounter is enabled.
+      void CheckFrameAllocations(uint64_t allocations);
 
       virtual void UpdateWindowTitle();
 
@@ -3,27 +3,107 @@
 //
 #pragma once
 
+#include <cstdint>
+
 namespace dg {
 
   class Time {
 
     public:
 
+      enum class Mode {
+        // Each frame updates the scene once, by the real time since the last
+        // frame.
+        Variable,
+
+        // The scene is updated in steps of exactly FixedDelta, as many per
+        // frame as real time calls for (at most MaxStepsPerFrame). Alpha
+        // tells rendering how far real time is into the next step. Window
+        // input is per frame, so a frame's key presses are seen by each of
+        // its steps.
+        FixedStep,
+
+        // Each frame updates the scene once, by exactly FixedDelta, however
+        // long it really took. For benchmarks and replays that must run the
+        // same way every time.
+        Deterministic,
+      };
+
+      // Real frame times over the last FrameWindow frames, in seconds.
+      // Percentiles are accurate to HistogramBucketWidth.
+      struct FrameStatistics {
+        int frames = 0;
+        double average = 0;
+        double p50 = 0;
+        double p95 = 0;
+        double p99 = 0;
+        double max = 0;
+      };
+
+      static const int FrameWindow = 600;
+      static constexpr double HistogramBucketWidth = 0.00025;
+
+      // Simulated time since the engine started, advanced by every update.
       static double Elapsed;
+      // Simulated time of the current update.
       static double Delta;
+      // Real time between the last two frames, regardless of mode.
+      static double FrameDelta;
+      // Frame rate over the last FrameWindow frames.
       static double AverageFrameRate;
       static double FrameNumber;
 
+      // Length of a step in FixedStep and Deterministic modes.
+      static double FixedDelta;
+      // Most steps a frame may take in FixedStep mode. Time beyond that is
+      // dropped, so that a long hitch doesn't turn into a spiral of ever
+      // longer frames.
+      static int MaxStepsPerFrame;
+      // In FixedStep mode, the fraction of a step that real time has
+      // advanced past the last update, in [0, 1). Rendering can blend
+      // between the previous and current updates' states by this much.
+      // Always 1 in the other modes.
+      static double Alpha;
+
+      static void SetMode(Mode mode);
+      static Mode GetMode();
+
       static void Reset();
+      // Measures the frame and decides how many updates it gets. Called by
+      // the engine at the start of every frame.
       static void Update();
+      // Advances to the frame's next update, setting Delta and Elapsed.
+      // Returns false once the frame has no updates left. Called by the
+      // engine around each scene update.
+      static bool Step();
+
+      static FrameStatistics GetFrameStatistics();
 
   private:
 
+      static const int HistogramBuckets = 400;
+
+      static double RealTime();
+      static void RecordFrameTime(double frameTime);
+
+      static Mode mode;
+      static double lastRealTime;
+      static double accumulator;
+      static int pendingSteps;
+      static double stepDelta;
+
+      // Ring buffer of the last FrameWindow real frame times.
+      static float frameTimes[FrameWindow];
+      static int frameTimeCount;
+      static int nextFrameTime;
+      static double frameTimeSum;
+      // Counts of frameTimes by HistogramBucketWidth, with the last bucket
+      // also counting everything longer.
+      static uint16_t histogram[HistogramBuckets];
+
 #if defined(_DIRECTX)
     static double perfCounterSeconds;
     static __int64 startTime;
-    static __int64 currentTime;
-    static __int64 previousTime;
 #endif
 
   }; // class Time
@@ -0,0 +1,105 @@
+//
+//  FrameArena.h
+//
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace dg {
+
+  // Linear allocator for bookkeeping that only lives until the end of a
+  // frame. Allocating bumps an offset into a block, deallocating is a no-op,
+  // and Reset() releases everything at once.
+  //
+  // If a frame outgrows the current block, more blocks are allocated from the
+  // heap. On the next Reset() they're replaced by a single block large enough
+  // for the whole frame, so that steady-state frames don't touch the heap.
+  class FrameArena {
+
+    public:
+
+      static const size_t DefaultCapacity = 64 * 1024;
+
+      // STL allocator that allocates from a FrameArena. A default-constructed
+      // allocator has no arena and can't allocate; containers using one must
+      // be assigned a container with a real allocator first.
+      template <typename T>
+      class Allocator {
+
+        public:
+
+          typedef T value_type;
+          typedef std::true_type propagate_on_container_copy_assignment;
+          typedef std::true_type propagate_on_container_move_assignment;
+          typedef std::true_type propagate_on_container_swap;
+
+          Allocator() = default;
+          Allocator(FrameArena &arena) : arena(&arena) {}
+          template <typename U>
+          Allocator(const Allocator<U> &other) : arena(other.arena) {}
+
+          T *allocate(size_t n) {
+            assert(arena != nullptr);
+            return (T *)arena->Allocate(n * sizeof(T), alignof(T));
+          }
+          void deallocate(T *, size_t) {}
+
+          template <typename U>
+          bool operator==(const Allocator<U> &other) const {
+            return arena == other.arena;
+          }
+          template <typename U>
+          bool operator!=(const Allocator<U> &other) const {
+            return arena != other.arena;
+          }
+
+        private:
+
+          FrameArena *arena = nullptr;
+
+          template <typename U>
+          friend class Allocator;
+
+      }; // class Allocator
+
+      FrameArena(size_t capacity = DefaultCapacity);
+      FrameArena(FrameArena &other) = delete;
+      FrameArena &operator=(FrameArena &other) = delete;
+
+      void *Allocate(size_t size, size_t alignment);
+
+      // Invalidates everything allocated since the last reset.
+      void Reset();
+
+      // Total size of the blocks currently held.
+      size_t Capacity() const;
+      // Bytes allocated since the last reset, including alignment padding.
+      inline size_t Used() const {
+        return used;
+      }
+
+    private:
+
+      struct Block {
+        std::unique_ptr<unsigned char[]> data;
+        size_t size;
+      };
+
+      void AddBlock(size_t size);
+
+      std::vector<Block> blocks;
+      // Offset into the last block.
+      size_t offset = 0;
+      size_t used = 0;
+
+  }; // class FrameArena
+
+  template <typename T>
+  using FrameVector = std::vector<T, FrameArena::Allocator<T>>;
+
+} // namespace dg
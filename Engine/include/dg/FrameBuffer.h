@@ -39,7 +39,22 @@ namespace dg {
       bool depthReadable = true;
       bool hasColor = true;
       bool hasStencil = true;
+      // Type of all of the framebuffer's textures. Every layer of a CUBEMAP
+      // or _2D_ARRAY framebuffer is rendered to at once, each primitive
+      // going to the face or layer a geometry shader picks with gl_Layer.
+      TextureType type = TextureType::_2D;
+      // Number of layers of a _2D_ARRAY framebuffer.
+      unsigned int layers = 1;
       std::vector<TextureOptions> textureOptions;
+
+      // Approximate GPU memory used by a framebuffer with these options,
+      // including its depth texture.
+      size_t EstimatedMemorySize() const;
+
+      friend bool operator==(const Options &a, const Options &b);
+      friend bool operator!=(const Options &a, const Options &b) {
+        return !(a == b);
+      }
     };
 
     static std::shared_ptr<FrameBuffer> Create(Options options);
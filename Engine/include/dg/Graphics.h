@@ -4,7 +4,7 @@
 
 #pragma once
 
-#include <forward_list>
+#include <array>
 #include <glm/glm.hpp>
 #include <memory>
 #include <unordered_map>
@@ -58,6 +58,21 @@ namespace dg {
       virtual void ClearDepthStencil(bool clearDepth = true,
                                      bool clearStencil = true) = 0;
 
+      // Limits ClearColor() and ClearDepthStencil() to a region of the
+      // render target, or lifts the limit if width and height are zero.
+      // Direct3D 11 can only clear whole views, so DirectX ignores this.
+      inline void SetClearRegion(int x, int y, int width, int height) {
+        clearRegion = glm::ivec4(x, y, width, height);
+      }
+
+      // Copies the contents of a framebuffer into one with the same options,
+      // and makes the destination the render target.
+      virtual void CopyFrameBuffer(FrameBuffer &source,
+                                   FrameBuffer &destination) = 0;
+
+      // Maximum number of simultaneously pushed rasterizer states.
+      static const int MAX_RASTERIZER_STATE_DEPTH = 16;
+
       void PushRasterizerState(const RasterizerState &state);
       void PopRasterizerState();
       void ApplyCurrentRasterizerState();
@@ -73,11 +88,44 @@ namespace dg {
 
       virtual void InitializeGraphics() = 0;
       virtual void InitializeResources();
-      virtual void ApplyRasterizerState(const RasterizerState &state) = 0;
+
+      // Applies a fully-declared state to the graphics API. If previous is
+      // not null, it's the state that was last applied, and only attributes
+      // that differ from it need to be applied.
+      virtual void ApplyRasterizerState(const RasterizerState &state,
+                                        const RasterizerState *previous) = 0;
+
+      // Forgets the last applied rasterizer state so that the next call to
+      // ApplyCurrentRasterizerState applies every attribute. Call this after
+      // changing API state outside of ApplyRasterizerState.
+      inline void InvalidateAppliedRasterizerState() {
+        hasAppliedRasterizerState = false;
+      }
 
       const RasterizerState emptyRasterizerState = RasterizerState();
-      std::forward_list<std::unique_ptr<RasterizerState>> states;
       glm::vec2 viewportDimensions = glm::vec2(0);
+      glm::ivec4 clearRegion = glm::ivec4(0);
+
+    private:
+
+      // Inline stack of flattened states. Only the first rasterizerStateDepth
+      // entries are valid.
+      std::array<RasterizerState, MAX_RASTERIZER_STATE_DEPTH> rasterizerStates;
+      int rasterizerStateDepth = 0;
+
+      // Results of RasterizerState::Flatten, keyed by the combined hash of the
+      // parent and child states.
+      struct FlattenedRasterizerState {
+        RasterizerState parent;
+        RasterizerState child;
+        RasterizerState flattened;
+      };
+      std::unordered_map<RasterizerState::hash_type, FlattenedRasterizerState>
+          flattenedRasterizerStates;
+
+      // The state most recently passed to ApplyRasterizerState.
+      RasterizerState appliedRasterizerState;
+      bool hasAppliedRasterizerState = false;
 
   }; // class Graphics
 
@@ -97,12 +145,17 @@ namespace dg {
                               bool clearStencil = true);
       virtual void ClearDepthStencil(bool clearDepth = true,
                                      bool clearStencil = true);
+      virtual void CopyFrameBuffer(FrameBuffer &source,
+                                   FrameBuffer &destination);
 
     protected:
 
       virtual void InitializeGraphics();
       virtual void InitializeResources();
-      virtual void ApplyRasterizerState(const RasterizerState &state);
+      virtual void ApplyRasterizerState(const RasterizerState &state,
+                                        const RasterizerState *previous);
+
+      void ClearWithin(const glm::ivec4 &region, GLbitfield clearBits);
 
       static GLenum ToGLEnum(RasterizerState::CullMode cullMode);
       static GLenum ToGLEnum(RasterizerState::DepthFunc depthFunc);
@@ -132,6 +185,8 @@ namespace dg {
                               bool clearStencil = true);
       virtual void ClearDepthStencil(bool clearDepth = true,
                                      bool clearStencil = true);
+      virtual void CopyFrameBuffer(FrameBuffer &source,
+                                   FrameBuffer &destination);
 
       ID3D11Device *device;
       ID3D11DeviceContext *context;
@@ -147,7 +202,8 @@ namespace dg {
     protected:
 
       virtual void InitializeGraphics();
-      virtual void ApplyRasterizerState(const RasterizerState &state);
+      virtual void ApplyRasterizerState(const RasterizerState &state,
+                                        const RasterizerState *previous);
 
     private:
 
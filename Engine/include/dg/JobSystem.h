@@ -0,0 +1,239 @@
+//
+//  JobSystem.h
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dg {
+
+  // Work-stealing thread pool owned by the engine.
+  //
+  // Every worker thread, as well as the main thread, has its own queue of
+  // jobs. A thread pushes and pops jobs at one end of its own queue, and once
+  // that's empty, steals from the other end of the other threads' queues.
+  // Threads that wait on work (TaskGroup::Wait(), Wait(), ParallelFor())
+  // run other jobs in the meantime, so tasks may fork and join freely.
+  //
+  // Tasks can depend on other tasks, and can be marked to run on the main
+  // thread, e.g. for GL work. Main-thread tasks run in RunMainThreadTasks(),
+  // which the engine calls once a frame, and while the main thread waits on
+  // a main-thread task or a group holding one. Background tasks only run on
+  // worker threads, so that they overlap whatever the main thread is doing.
+  //
+  // The static functions are safe to call from anywhere, including Scenes
+  // and Behaviors. If the job system hasn't been initialized, work runs
+  // serially on the calling thread.
+  class JobSystem {
+
+    public:
+
+      class Task;
+      class TaskGroup;
+      typedef std::shared_ptr<Task> TaskHandle;
+      typedef void (*RangeFunction)(const void *context, size_t begin,
+                                    size_t end);
+
+      struct WorkerStatistics {
+        uint64_t jobsExecuted = 0;
+        // Jobs this thread took from another thread's queue.
+        uint64_t jobsStolen = 0;
+        double busySeconds = 0;
+        // Fraction of the time since statistics were last reset that the
+        // thread spent running jobs.
+        double utilization = 0;
+      };
+
+      // A function that runs once all of its dependencies have finished.
+      class Task {
+
+        public:
+
+          Task() = default;
+          Task(Task &other) = delete;
+          Task &operator=(Task &other) = delete;
+
+          inline bool IsFinished() const {
+            return finished.load(std::memory_order_acquire);
+          }
+
+        private:
+
+          std::function<void()> fn;
+          TaskGroup *group = nullptr;
+          bool mainThread = false;
+          bool background = false;
+          // Unfinished dependencies, plus one until the task is submitted.
+          std::atomic<int> remaining{1};
+          std::atomic<bool> finished{false};
+          // Guards dependents and the transition to finished.
+          std::mutex mutex;
+          std::vector<TaskHandle> dependents;
+          // Keeps the task alive while it's queued.
+          TaskHandle self;
+          std::exception_ptr exception;
+
+          friend class JobSystem;
+
+      }; // class Task
+
+      // Fork/join scope for a set of tasks.
+      class TaskGroup {
+
+        public:
+
+          TaskGroup() = default;
+          TaskGroup(TaskGroup &other) = delete;
+          TaskGroup &operator=(TaskGroup &other) = delete;
+          // Waits for any remaining tasks.
+          ~TaskGroup();
+
+          TaskHandle Run(std::function<void()> fn,
+                         const std::vector<TaskHandle> &dependencies = {});
+          TaskHandle RunOnMainThread(
+              std::function<void()> fn,
+              const std::vector<TaskHandle> &dependencies = {});
+
+          // Waits for every task in the group, running other work in the
+          // meantime. Rethrows the first exception thrown by any of them.
+          void Wait();
+
+        private:
+
+          std::atomic<int> pending{0};
+          // Pending tasks that run on the main thread.
+          std::atomic<int> pendingMainThread{0};
+          std::mutex exceptionMutex;
+          std::exception_ptr exception;
+
+          friend class JobSystem;
+
+      }; // class TaskGroup
+
+      static std::unique_ptr<JobSystem> Instance;
+
+      // Starts threadCount - 1 worker threads, with the calling thread
+      // becoming the main thread. If threadCount is 0, it's taken from the
+      // hardware concurrency.
+      static void Initialize(int threadCount = 0);
+      // Stops the worker threads, and finishes any queued jobs on the
+      // calling thread.
+      static void Shutdown();
+
+      JobSystem(JobSystem &other) = delete;
+      JobSystem &operator=(JobSystem &other) = delete;
+      ~JobSystem();
+
+      // Calls fn(begin, end) for consecutive subranges of [0, count), each of
+      // at most grainSize elements, across the worker threads and the
+      // calling thread. Returns once every subrange has been processed, and
+      // rethrows the first exception thrown by fn. Doesn't allocate.
+      template <typename Function>
+      static void ParallelFor(size_t count, size_t grainSize,
+                              const Function &fn) {
+        Run(count, grainSize,
+            [](const void *context, size_t begin, size_t end) {
+              (*(const Function *)context)(begin, end);
+            },
+            &fn);
+      }
+
+      static TaskHandle Submit(
+          std::function<void()> fn,
+          const std::vector<TaskHandle> &dependencies = {});
+      static TaskHandle SubmitOnMainThread(
+          std::function<void()> fn,
+          const std::vector<TaskHandle> &dependencies = {});
+      // Submits a task that the main thread never runs, not even while it
+      // waits, unless there are no worker threads to run it.
+      static TaskHandle SubmitInBackground(
+          std::function<void()> fn,
+          const std::vector<TaskHandle> &dependencies = {});
+
+      // Waits for the task, running other work in the meantime. Rethrows
+      // any exception the task threw.
+      static void Wait(const TaskHandle &task);
+
+      // Runs the main-thread tasks whose dependencies have finished. Must
+      // be called from the main thread.
+      static void RunMainThreadTasks();
+
+      // Number of threads that run jobs, including the main thread.
+      static int ThreadCount();
+
+      // Per-thread statistics, with the main thread first.
+      static std::vector<WorkerStatistics> GetStatistics();
+      static void ResetStatistics();
+
+    private:
+
+      struct Job {
+        void (*execute)(void *data);
+        void *data;
+      };
+
+      class WorkQueue;
+      struct Worker;
+
+      explicit JobSystem(int threadCount);
+
+      static void Run(size_t count, size_t grainSize, RangeFunction fn,
+                      const void *context);
+      static TaskHandle CreateTask(std::function<void()> fn,
+                                   const std::vector<TaskHandle> &dependencies,
+                                   TaskGroup *group, bool mainThread,
+                                   bool background = false);
+      static void RunTaskJob(void *data);
+      static void RunLoopJob(void *data);
+      static void FinishTask(Task &task);
+
+      // Stops the worker threads, then finishes any queued jobs on the
+      // calling thread.
+      void Stop();
+      void Schedule(const TaskHandle &task);
+      void Push(const Job &job, bool background = false);
+      bool TryRunJob();
+      bool TrySteal(int thief, Job &job);
+      void Execute(const Job &job, int workerIndex, bool stolen);
+      void RunMainThreadTasksInternal();
+      void WorkerLoop(int index);
+      // Runs other work until done() returns true. On the main thread,
+      // main-thread tasks are only run if runMainThreadTasks is set.
+      template <typename Predicate>
+      void HelpUntil(const Predicate &done, bool runMainThreadTasks);
+
+      std::vector<std::unique_ptr<Worker>> workers;
+      // Jobs pushed from threads that aren't part of the job system.
+      std::unique_ptr<WorkQueue> sharedQueue;
+      // Background tasks, which only worker threads take.
+      std::unique_ptr<WorkQueue> backgroundQueue;
+      std::vector<std::thread> threads;
+      std::thread::id mainThreadID;
+
+      std::mutex mainThreadMutex;
+      std::vector<TaskHandle> mainThreadTasks;
+
+      // Jobs in all queues, for waking and sleeping workers.
+      std::atomic<int> queuedJobs{0};
+      std::atomic<int> sleepingWorkers{0};
+      std::mutex sleepMutex;
+      std::condition_variable wake;
+      bool quit = false;
+      bool stopped = false;
+
+      std::chrono::steady_clock::time_point statisticsStart;
+
+  }; // class JobSystem
+
+} // namespace dg
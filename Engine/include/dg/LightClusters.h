@@ -0,0 +1,120 @@
+//
+//  LightClusters.h
+//
+
+#pragma once
+
+#if defined(_OPENGL)
+#include "dg/opengl/glad/glad.h"
+#endif
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+#include "dg/FrameArena.h"
+#include "dg/Lights.h"
+
+namespace dg {
+
+  // Assigns lights to the clusters of a view, so that each fragment only
+  // shades the lights that can reach it.
+  //
+  // A perspective view is divided into TilesX * TilesY tiles across the
+  // screen and Slices slices in depth, spaced exponentially between the
+  // near and far planes. Build() lists every point and spot light in each
+  // cluster that its Light::Range() overlaps. Directional lights, and lights
+  // whose brightness never falls off, are global: they come first in the
+  // light data and apply to every cluster. Views that
+  // aren't perspective get a single cluster, with every light global.
+  //
+  // Each slice is assigned on its own JobSystem task, testing lights'
+  // bounding spheres against the slice's cluster bounds in view space.
+  //
+  // With OpenGL, the result is uploaded to three buffer textures, read by
+  // assets/shaders/includes/light_clusters.glsl:
+  //   - Light data: LightDataTexels RGBA32F texels per light.
+  //   - Light grid: an RG32UI (offset, count) per cluster into the indices.
+  //   - Light indices: R16UI indices into the light data.
+  //
+  // Copy is disabled to prevent resource leaks.
+  class LightClusters {
+
+    public:
+
+      static const int TilesX = 16;
+      static const int TilesY = 9;
+      static const int Slices = 24;
+      static const int LightDataTexels = 11;
+
+      LightClusters() = default;
+      LightClusters(LightClusters &other) = delete;
+      LightClusters &operator=(LightClusters &other) = delete;
+      ~LightClusters();
+
+      void Build(const FrameVector<Light::ShaderData> &lights,
+                 const glm::mat4x4 &view, const glm::mat4x4 &projection);
+
+      glm::ivec3 GetDimensions() const;
+      // Slice of a view-space depth d is log(d) * depthScale + depthBias.
+      float GetDepthScale() const;
+      float GetDepthBias() const;
+      int GetLightCount() const;
+      int GetGlobalLightCount() const;
+      // Total length of all clusters' light lists.
+      size_t GetIndexCount() const;
+
+#if defined(_OPENGL)
+      GLuint GetLightDataTexture() const;
+      GLuint GetLightGridTexture() const;
+      GLuint GetLightIndicesTexture() const;
+#endif
+
+    private:
+
+      // Bounding spheres of local lights in view space, stored as separate
+      // arrays so that testing them against a slice vectorizes.
+      struct Spheres {
+        std::vector<float> x;
+        std::vector<float> y;
+        // Distance in front of the camera, i.e. -z in view space.
+        std::vector<float> depth;
+        std::vector<float> radius;
+        std::vector<uint16_t> index;
+      };
+
+      struct SliceScratch {
+        std::vector<uint16_t> candidates;
+        // (cluster in slice, light) pairs as found, and then sorted by
+        // cluster.
+        std::vector<std::pair<uint16_t, uint16_t>> pairs;
+        std::vector<uint16_t> indices;
+        uint32_t counts[TilesX * TilesY];
+      };
+
+      void AssignSlice(int slice, const glm::mat4x4 &projection);
+      void PackLight(const Light::ShaderData &light);
+      void Upload();
+
+      glm::ivec3 dimensions = glm::ivec3(1);
+      float depthScale = 0;
+      float depthBias = 0;
+      float nearDepth = 0;
+      float farDepth = 0;
+      int globalLightCount = 0;
+
+      Spheres spheres;
+      std::vector<SliceScratch> slices;
+
+      // Results, in the layout they're uploaded in.
+      std::vector<glm::vec4> lightData;
+      std::vector<glm::uvec2> grid;
+      std::vector<uint16_t> indices;
+
+#if defined(_OPENGL)
+      GLuint buffers[3] = {0, 0, 0};
+      GLuint textures[3] = {0, 0, 0};
+#endif
+
+  }; // class LightClusters
+
+} // namespace dg
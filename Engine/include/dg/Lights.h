@@ -5,6 +5,7 @@
 #pragma once
 
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
 #include "dg/SceneObject.h"
 #include "dg/Texture.h"
 
@@ -16,12 +17,22 @@ namespace dg {
 
     public:
 
+      // Most lights sent through the LIGHTS_ARRAY_NAME uniform array. The
+      // OpenGL standard shader reads every light from LightClusters instead.
+      //
       // NOTE: Keep these values consistent with:
       //       -> assets/shaders/fragment_head.glsl
       //       -> assets/shaders/StandardPixelShader.hlsl.
       static const char *LIGHTS_ARRAY_NAME;
       static const int MAX_LIGHTS = 8;
 
+      // Most point lights casting shadows at once, each into its own cube
+      // map.
+      //
+      // NOTE: Keep this consistent with:
+      //       -> assets/shaders/includes/shadow_cubes.glsl.
+      static const int MAX_SHADOW_CUBES = 4;
+
       // NOTE: Keep this struct consistent with:
       //       -> assets/shaders/fragment_head.glsl
       //       -> assets/shaders/StandardPixelShader.hlsl.
@@ -32,6 +43,21 @@ namespace dg {
         DIRECTIONAL = 3,
       };
 
+      // Where a light's shadow is found, as ShaderData::hasShadow.
+      //
+      // NOTE: Keep these values consistent with:
+      //       -> assets/shaders/includes/shared_head.glsl.
+      enum class ShadowType : int {
+        NONE     = 0,
+        // A region of a shadow atlas, given by shadowRect.
+        ATLAS    = 1,
+        // The layers of a ShadowCascades texture array.
+        CASCADES = 2,
+        // A cube map of depths around a point light, seen through
+        // lightTransform, which is the projection shared by its faces.
+        CUBE     = 3,
+      };
+
       // Struct size must be a multiple of 16 bytes, and vectors cannot
       // cross 16-byte boundaries. Hence the confusing order and 3 bytes of
       // padding.
@@ -54,12 +80,40 @@ namespace dg {
         int hasShadow = 0;
         glm::vec2 _padding;
         glm::mat4x4 lightTransform;
+        // Region of the shadow map holding this light's shadow, as
+        // (offset, scale) in texture coordinates. For shadow cubes, x is
+        // instead the index of the cube among the shadow cubes bound to
+        // shaders.
+        glm::vec4 shadowRect = glm::vec4(0, 0, 1, 1);
       };
 
+      // Fraction of a light's brightness below which it's considered to have
+      // no effect, setting how far it reaches.
+      static constexpr float CutoffIntensity = 1.0f / 256.0f;
+
+      // Brightest color channel of the light's ambient, diffuse, and
+      // specular colors.
+      static float Brightness(const ShaderData &light);
+      // How much of the light's color remains at a distance from it.
+      static float Attenuation(const ShaderData &light, float distance);
+      // Distance at which the light's brightness falls to CutoffIntensity,
+      // or infinity if it never does.
+      static float Range(const ShaderData &light);
+
       void SetAmbient(const glm::vec3& ambient);
       void SetDiffuse(const glm::vec3& diffuse);
       void SetSpecular(const glm::vec3& specular);
-      void SetShadowMap(std::shared_ptr<Texture> shadowMap);
+      // Sets the texture holding the light's shadow, which may be shared with
+      // other lights' shadows, in which case shadowRect is the region of it
+      // this light's shadow occupies.
+      void SetShadowMap(std::shared_ptr<Texture> shadowMap,
+                        const glm::vec4 &shadowRect = glm::vec4(0, 0, 1, 1));
+      // Sets the texture array holding the layers of the light's
+      // ShadowCascades.
+      void SetShadowCascades(std::shared_ptr<Texture> cascadeMap);
+      // Sets the cube map holding a point light's shadow, bound to shaders
+      // as shadow cube number index.
+      void SetShadowCube(std::shared_ptr<Texture> cubeMap, int index);
       void SetCastShadows(bool castShadows);
       void SetLightTransform(const glm::mat4x4 &xf);
 
@@ -67,6 +121,7 @@ namespace dg {
       glm::vec3 GetDiffuse() const;
       glm::vec3 GetSpecular() const;
       std::shared_ptr<Texture> GetShadowMap() const;
+      const glm::vec4 &GetShadowRect() const;
       bool GetCastShadows() const;
       const glm::mat4x4 &GetLightTransform() const;
 
@@ -12,6 +12,9 @@
 
 namespace dg {
 
+  class LightClusters;
+  class ShadowCascades;
+
   // Value for rendering order.
   enum class RenderQueue : int {
     Background  = 1000,
@@ -116,7 +119,23 @@ namespace dg {
       void SendMatrixP(glm::mat4x4 p);
       void SendMatrixNormal(glm::mat4x4 normal);
       void SendLights(const Light::ShaderData(&lights)[Light::MAX_LIGHTS]);
+      // Whether the shader reads lights sent by SendLights(). Must be
+      // called after Use().
+      bool UsesLightArray() const;
       void SendShadowMap(std::shared_ptr<Texture> shadowMap);
+      // Binds the clustered lights read by
+      // assets/shaders/includes/light_clusters.glsl. With null, shaders see
+      // no lights.
+      void SendLightClusters(const LightClusters *clusters);
+      // Binds the cascaded shadow maps read by
+      // assets/shaders/includes/shadow_cascades.glsl. With null, shaders see
+      // no cascades.
+      void SendShadowCascades(const ShadowCascades *cascades);
+      // Binds the point lights' shadow cubes read by
+      // assets/shaders/includes/shadow_cubes.glsl. Null entries, or all of
+      // them with null, are left unbound.
+      void SendShadowCubes(
+          const std::shared_ptr<Texture> (*cubes)[Light::MAX_SHADOW_CUBES]);
 
       void Use() const;
 
@@ -127,13 +146,16 @@ namespace dg {
 
       enum class TexUnitHints {
         SHADOWMAP = 0,
-
-        END,
+        LIGHT_DATA,
+        LIGHT_GRID,
+        LIGHT_INDICES,
+        SHADOW_CASCADES,
+        // One unit for each of Light::MAX_SHADOW_CUBES.
+        SHADOW_CUBES,
+
+        END = SHADOW_CUBES + Light::MAX_SHADOW_CUBES,
       };
 
-      static const std::string LightProperty(
-          int index, const std::string& property);
-
 #if defined(_OPENGL)
       void SendLight(int index, const Light::ShaderData& data);
       void ClearLights();
@@ -136,6 +136,11 @@ namespace dg {
 
       const Vertex GetVertex(int i) const;
 
+      // Sphere around the box bounding every vertex, in the mesh's own
+      // space.
+      glm::vec3 GetBoundsCenter() const;
+      float GetBoundsRadius() const;
+
       virtual void Draw() const;
       virtual bool IsDrawable() const = 0;
 
@@ -152,6 +157,10 @@ namespace dg {
       std::vector<glm::vec3> vertexTangents;
       std::vector<unsigned int> indices;
 
+      // Box bounding vertexPositions.
+      glm::vec3 boundsMin = glm::vec3(0);
+      glm::vec3 boundsMax = glm::vec3(0);
+
       // Bitmask of which attributes this mesh's vertices have.
       // If no vertices added yet, value is NONE.
       Vertex::AttrFlag attributes = Vertex::AttrFlag::NONE;
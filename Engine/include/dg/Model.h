@@ -13,6 +13,9 @@
 
 namespace dg {
 
+  class LightClusters;
+  class ShadowCascades;
+
   class Model : public SceneObject {
 
     public:
@@ -22,7 +25,14 @@ namespace dg {
         glm::mat4x4 projection = glm::mat4x4(1);
         const glm::vec3 *cameraPos = nullptr;
         const Light::ShaderData (*lights)[Light::MAX_LIGHTS] = nullptr;
+        const LightClusters *lightClusters = nullptr;
         std::shared_ptr<Texture> shadowMap = nullptr;
+        const ShadowCascades *shadowCascades = nullptr;
+        const std::shared_ptr<Texture> (*shadowCubes)[Light::MAX_SHADOW_CUBES] =
+            nullptr;
+        // Precomputed projection * view * model matrix. If null, it's
+        // computed when drawing.
+        const glm::mat4x4 *matrixMVP = nullptr;
       };
 
       Model();
@@ -37,12 +47,26 @@ namespace dg {
       std::shared_ptr<Material> material = nullptr;
       Scene::LayerMask layer = Scene::LayerMask::Default();
 
+      // Whether the model is expected to stay put. Shadows of static models
+      // are cached, and only rendered again when the light or a static model
+      // in its view moves. See Scene::RenderShadowAtlas().
+      bool isStatic = false;
+
       void Draw(glm::mat4x4 view, glm::mat4x4 projection,
                 Material *material = nullptr) const;
 
       void Draw(const DrawContext &context,
                 Material *material = nullptr) const;
 
+      // The parts of Draw() that only depend on the material and context,
+      // and the parts that depend on this model. Consecutive models drawn
+      // with the same material only need to call BeginMaterial() and
+      // EndMaterial() once around all of their DrawWithMaterial() calls.
+      static void BeginMaterial(const DrawContext &context, Material *material);
+      void DrawWithMaterial(const DrawContext &context,
+                            Material *material) const;
+      static void EndMaterial(Material *material);
+
   }; // class Model
 
 } // namespace dg
@@ -5,7 +5,9 @@
 #pragma once
 
 #include <cassert>
+#include <filesystem>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -14,11 +16,29 @@
 
 namespace dg {
 
+  // Resolves #include directives in GLSL files.
+  //
+  // Files are read and tokenized once per process and cached by their
+  // flattened path, until their modification time changes. Each
+  // Preprocessor instance then only assembles the cached pieces of its file
+  // and includes into one string.
+  //
+  // #ifdef, #ifndef, #else, #elif, #endif, #define, and #undef are tracked so
+  // that includes inside inactive conditional blocks are skipped. #if and
+  // #elif expressions aren't evaluated, so their blocks are always treated
+  // as active. All directives other than #include are passed through for the
+  // shader compiler to handle.
+  //
+  // Separate instances may be processed on different threads concurrently.
   class Preprocessor {
 
     public:
 
       static std::shared_ptr<Preprocessor> ForFile(const std::string &filename);
+      // Each define is injected as "#define <define>" right after the
+      // #version directive of the file.
+      static std::shared_ptr<Preprocessor> ForFile(
+          const std::string &filename, const std::vector<std::string> &defines);
 
       const std::string &GetProcessedContent();
       inline const std::string &GetFilename() const {
@@ -27,44 +47,105 @@ namespace dg {
 
     private:
 
+      enum class DirectiveType {
+        NONE,
+
+        VERSION,
+        INCLUDE,
+        DEFINE,
+        UNDEF,
+        IF,
+        IFDEF,
+        IFNDEF,
+        ELIF,
+        ELSE,
+        ENDIF,
+      };
+
+      // A run of whole lines of a file. Directive segments are always a
+      // single line.
+      struct Segment {
+        DirectiveType directive = DirectiveType::NONE;
+        size_t start = 0;
+        size_t length = 0;
+        int line = 0;
+        // Flattened path for INCLUDE, macro name for DEFINE, UNDEF, IFDEF,
+        // and IFNDEF.
+        std::string argument;
+      };
+
       struct File {
         std::string filename;
-        std::vector<std::string> lines;
-        std::string processedContent;
-        int id;
-        bool processed = false;
+        std::filesystem::file_time_type modifiedTime;
+        std::string content;
+        std::vector<Segment> segments;
+      };
+
+      // State of an enclosing #if, #ifdef, or #ifndef block.
+      struct Conditional {
+        // Whether the enclosing blocks are all active.
+        bool parentActive;
+        // Whether the current branch is active.
+        bool active;
+        // Whether any branch so far has been active. Only meaningful if
+        // known is true.
+        bool taken;
+        // False for #if and #elif blocks, whose conditions aren't evaluated.
+        bool known;
       };
 
       class UnterminatedQuoteError : public EngineError {
         public:
-          UnterminatedQuoteError(const File &file, int line)
+          UnterminatedQuoteError(const std::string &filename, int line)
               : EngineError("Unterminated quote on #include in file " +
-                            file.filename + ":" + std::to_string(line)) {}
+                            filename + ":" + std::to_string(line)) {}
       };
 
       class EmptyError : public EngineError {
         public:
-          EmptyError(const File &file, int line)
+          EmptyError(const std::string &filename, int line)
               : EngineError("Empty #include for file " +
-                            file.filename + ":" + std::to_string(line)) {}
+                            filename + ":" + std::to_string(line)) {}
       };
 
       class CycleError : public EngineError {
         public:
-          CycleError(const File &file, int line)
+          CycleError(const std::string &filename, int line)
               : EngineError("Include cycle detected for file " +
-                            file.filename + ":" + std::to_string(line)) {}
+                            filename + ":" + std::to_string(line)) {}
       };
 
       Preprocessor() = default;
 
-      File &GetFile(const std::string &filename);
-      File &GetProcessedFile(File &file);
+      static std::shared_ptr<const File> GetFile(const std::string &filename);
+      static void TokenizeFile(File &file);
+      static std::string StripComments(const std::string &content,
+                                       size_t start, size_t end,
+                                       bool &inBlockComment);
+
+      void AppendFile(const File &file, std::string &output);
+      bool IsActive() const;
+      // Source string number of a file in #line directives.
+      int FileID(const std::string &filename);
 
       std::string filename;
-      std::unordered_map<std::string, File> files;
+      std::vector<std::string> defines;
+      std::string processedContent;
+      bool processed = false;
+
+      // Assembly state.
       std::set<std::string> currentFilenames;
-      int nextFileID = 0;
+      std::set<std::string> definedNames;
+      std::vector<Conditional> conditionals;
+      // Numbers files in the order they're first included, starting with
+      // this file at 0, so that the processed content doesn't depend on
+      // which shaders were loaded first.
+      std::unordered_map<std::string, int> fileIDs;
+
+      static std::unordered_map<std::string, std::shared_ptr<const File>>
+          fileCache;
+      // Guards fileCache.
+      static std::mutex fileCacheMutex;
 
   }; // class Preprocessor
 
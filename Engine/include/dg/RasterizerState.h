@@ -70,6 +70,11 @@ namespace dg {
       RasterizerState(const RasterizerState &);
 
       bool HasDeclaredAttributes() const;
+      bool DeclaresAllAttributes() const;
+
+      // Hash of the declared attributes and their values. This is cached
+      // until the state is next modified.
+      hash_type GetHash() const;
 
       // Automatically create Setters, Getters, and Clearers for all possible
       // RasterizerState attributes.
@@ -88,6 +93,15 @@ namespace dg {
       friend std::ostream &operator<<(std::ostream &os,
                                       const RasterizerState &state);
 
+      // States are equal if they declare the same attributes with the same
+      // values and importance. Values of undeclared attributes are ignored.
+      friend bool operator==(const RasterizerState &lhs,
+                             const RasterizerState &rhs);
+      friend inline bool operator!=(const RasterizerState &lhs,
+                                    const RasterizerState &rhs) {
+        return !(lhs == rhs);
+      }
+
       // Flags to keep trach of which attributes this state has declared or
       // might wish to override on child states.
       enum class AttrFlag : uint32_t {
@@ -138,11 +152,18 @@ namespace dg {
       // override non-important child states' attributes.
       AttrFlag importantAttributes = AttrFlag::None;
 
+      // Mask of every attribute a state can declare.
+      static const AttrFlag AllAttributes;
+
       // This state's declared attribute values.
 #define STATE_ATTRIBUTE(index, attr_type, name, member_name) \
       attr_type member_name;
 #include "dg/RasterizerStateAttributes.def"
 
+      // Cached result of GetHash(), valid only if hashValid is true.
+      mutable hash_type hash = 0;
+      mutable bool hashValid = false;
+
       inline void SetImportant(AttrFlag attr, bool important) {
         if (important) {
           importantAttributes |= attr;
@@ -187,15 +208,7 @@ namespace std {
     typedef dg::RasterizerState argument_type;
     typedef dg::RasterizerState::hash_type result_type;
     result_type operator()(const argument_type &rs) const noexcept {
-      result_type h = 0;
-      hash_combine(h, rs.declaredAttributes);
-      hash_combine(h, rs.importantAttributes);
-#define STATE_ATTRIBUTE(index, attr_type, public_name, member_name) \
-      if (rs.Declares##public_name()) { \
-        hash_combine(h, rs.member_name); \
-      }
-#include "dg/RasterizerStateAttributes.def"
-      return h;
+      return rs.GetHash();
     }
   }; // struct hash
 
@@ -0,0 +1,179 @@
+//
+//  RenderGraph.h
+//
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "dg/Exceptions.h"
+#include "dg/FrameBuffer.h"
+
+namespace dg {
+
+  // Declarative description of a frame's render passes and the framebuffers
+  // they read and write.
+  //
+  // Each frame, passes are added along with the resources they use. The
+  // graph then culls passes whose output nothing needs, orders the rest so
+  // that every pass runs after the passes writing what it reads, and assigns
+  // each transient framebuffer to a physical one. Transient framebuffers
+  // with identical options whose lifetimes don't overlap share the same
+  // physical framebuffer. Physical framebuffers are acquired from the
+  // ResourcePool and released back to it when the next frame starts, so
+  // steady-state frames reuse the same ones.
+  //
+  // Passes marked with side effects (e.g. drawing to the window) are never
+  // culled, and are the roots that decide which other passes are needed.
+  //
+  // The graph keeps its passes, resources, and scratch space from one frame
+  // to the next, so describing and executing the same frame again doesn't
+  // allocate. For that, names must be strings that outlive the frame, such
+  // as literals, and execute functions should capture no more than a couple
+  // of pointers or indices, which std::function stores without allocating.
+  class RenderGraph {
+
+    public:
+
+      // Identifies a framebuffer resource within the current frame.
+      typedef int Resource;
+      static const Resource InvalidResource = -1;
+
+      class PassBuilder {
+
+        public:
+
+          void Read(Resource resource);
+          void Write(Resource resource);
+          // Prevents the pass from being culled.
+          void SideEffect();
+
+        private:
+
+          PassBuilder(RenderGraph &graph, int pass)
+              : graph(graph), pass(pass) {}
+
+          RenderGraph &graph;
+          int pass;
+
+          friend class RenderGraph;
+
+      }; // class PassBuilder
+
+      struct Statistics {
+        int passes = 0;
+        int culledPasses = 0;
+        int transientResources = 0;
+        int physicalFrameBuffers = 0;
+        // Most estimated render-target memory that transient resources
+        // occupied at any point during the frame.
+        size_t peakBytes = 0;
+        // Estimated memory of all physical framebuffers used this frame.
+        size_t allocatedBytes = 0;
+        // Estimated memory the transient resources would have needed
+        // without aliasing.
+        size_t unaliasedBytes = 0;
+      };
+
+      RenderGraph() = default;
+      RenderGraph(RenderGraph &other) = delete;
+      RenderGraph &operator=(RenderGraph &other) = delete;
+      ~RenderGraph();
+
+      // Starts describing a new frame, discarding the last one's passes and
+      // resources.
+      void Reset();
+
+      // Declares a framebuffer that only lives for the current frame.
+      Resource CreateFrameBuffer(const char *name,
+                                 const FrameBuffer::Options &options);
+      // Declares a framebuffer owned outside of the graph.
+      Resource ImportFrameBuffer(const char *name,
+                                 std::shared_ptr<FrameBuffer> framebuffer);
+
+      // Adds a pass. setup declares what it reads and writes, and execute is
+      // called when the graph is executed, unless the pass was culled.
+      void AddPass(const char *name,
+                   const std::function<void(PassBuilder &)> &setup,
+                   std::function<void(RenderGraph &)> execute);
+
+      // Culls, orders, allocates, and runs the passes.
+      void Execute();
+
+      // Returns the physical framebuffer of a resource. Only valid while
+      // executing a pass that reads or writes it.
+      std::shared_ptr<FrameBuffer> GetFrameBuffer(Resource resource) const;
+
+      inline const Statistics &GetStatistics() const {
+        return statistics;
+      }
+
+    private:
+
+      struct ResourceEntry {
+        const char *name = nullptr;
+        FrameBuffer::Options options;
+        // Non-null for imported resources, and for transient resources once
+        // they've been assigned a physical framebuffer.
+        std::shared_ptr<FrameBuffer> framebuffer;
+        bool imported = false;
+        std::vector<int> writers;
+        // Positions in the execution order of the first and last passes
+        // that use this resource.
+        int firstUse = -1;
+        int lastUse = -1;
+      };
+
+      struct Pass {
+        const char *name = nullptr;
+        std::function<void(RenderGraph &)> execute;
+        std::vector<Resource> reads;
+        std::vector<Resource> writes;
+        bool sideEffect = false;
+        bool culled = true;
+      };
+
+      struct PhysicalFrameBuffer {
+        std::shared_ptr<FrameBuffer> framebuffer;
+        size_t size = 0;
+        // Position of the last pass using it so far.
+        int busyUntil = -1;
+      };
+
+      class CycleError : public EngineError {
+        public:
+          CycleError(const std::string &pass)
+              : EngineError("Render graph has a dependency cycle at pass " +
+                            pass) {}
+      };
+
+      ResourceEntry &AddResource(const char *name);
+      void Cull();
+      // Fills order with the passes that weren't culled, in the order they
+      // should run.
+      void Order();
+      void Allocate();
+      void ReleaseFrameBuffers();
+
+      // Only the first resourceCount resources and passCount passes belong
+      // to the current frame. The rest are kept for their storage.
+      std::vector<ResourceEntry> resources;
+      std::vector<Pass> passes;
+      int resourceCount = 0;
+      int passCount = 0;
+      std::vector<PhysicalFrameBuffer> physicalFrameBuffers;
+      Statistics statistics;
+
+      // Scratch space for compiling the frame.
+      std::vector<int> remaining;
+      std::vector<std::vector<int>> dependents;
+      std::vector<int> dependencyCounts;
+      std::vector<int> ready;
+      std::vector<int> order;
+      std::vector<Resource> transients;
+
+  }; // class RenderGraph
+
+} // namespace dg
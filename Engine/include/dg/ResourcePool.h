@@ -0,0 +1,108 @@
+//
+//  ResourcePool.h
+//
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "dg/FrameBuffer.h"
+#include "dg/Texture.h"
+
+namespace dg {
+
+  // Recycles framebuffers and textures that are only needed for a while,
+  // such as render targets sized to the window or per-frame temporaries.
+  //
+  // Acquire-() hands out a free resource created with the same options, or
+  // creates one if there's none. Release-() returns it to the pool, after
+  // which it may be handed out again. A resource whose only remaining owner
+  // is the pool is also treated as released at the end of the frame, so
+  // dropping every reference to an acquired resource returns it as well.
+  //
+  // Free resources that haven't been used for TrimFrames frames are
+  // destroyed in EndFrame(), which the engine calls every frame. This way,
+  // resizing the window or toggling an effect only creates GPU resources
+  // once, and ones for old sizes go away after a while.
+  //
+  // The static functions are safe to call from anywhere on the main thread.
+  // If the pool hasn't been initialized, Acquire-() creates a new resource
+  // every time and Release-() does nothing.
+  class ResourcePool {
+
+    public:
+
+      static const uint64_t DefaultTrimFrames = 120;
+
+      struct Statistics {
+        int frameBuffers = 0;
+        int textures = 0;
+        // Of the above, the number currently handed out.
+        int frameBuffersInUse = 0;
+        int texturesInUse = 0;
+        // Estimated GPU memory of every pooled resource.
+        size_t bytes = 0;
+        // Acquisitions since the pool was initialized, and how many of them
+        // needed a new resource.
+        uint64_t acquired = 0;
+        uint64_t created = 0;
+        uint64_t trimmed = 0;
+      };
+
+      static std::unique_ptr<ResourcePool> Instance;
+
+      static void Initialize(uint64_t trimFrames = DefaultTrimFrames);
+      // Destroys every pooled resource. Resources still referenced elsewhere
+      // live on, but are no longer recycled.
+      static void Shutdown();
+
+      ResourcePool(ResourcePool &other) = delete;
+      ResourcePool &operator=(ResourcePool &other) = delete;
+
+      static std::shared_ptr<FrameBuffer> AcquireFrameBuffer(
+          const FrameBuffer::Options &options);
+      static void ReleaseFrameBuffer(
+          const std::shared_ptr<FrameBuffer> &framebuffer);
+
+      static std::shared_ptr<Texture> AcquireTexture(
+          const TextureOptions &options);
+      static void ReleaseTexture(const std::shared_ptr<Texture> &texture);
+
+      // Reclaims resources nothing references anymore, and destroys the ones
+      // that have been free for too long.
+      static void EndFrame();
+
+      static Statistics GetStatistics();
+
+    private:
+
+      template <typename Resource>
+      struct Entry {
+        std::shared_ptr<Resource> resource;
+        size_t size = 0;
+        bool inUse = false;
+        uint64_t lastUsedFrame = 0;
+      };
+
+      explicit ResourcePool(uint64_t trimFrames);
+
+      template <typename Resource, typename Options, typename Create>
+      std::shared_ptr<Resource> Acquire(std::vector<Entry<Resource>> &entries,
+                                        const Options &options,
+                                        const Create &create);
+      template <typename Resource>
+      void Release(std::vector<Entry<Resource>> &entries,
+                   const std::shared_ptr<Resource> &resource);
+      template <typename Resource>
+      void Trim(std::vector<Entry<Resource>> &entries);
+
+      std::vector<Entry<FrameBuffer>> frameBuffers;
+      std::vector<Entry<Texture>> textures;
+      uint64_t trimFrames;
+      uint64_t frame = 0;
+      Statistics statistics;
+
+  }; // class ResourcePool
+
+} // namespace dg
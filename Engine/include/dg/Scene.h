@@ -5,15 +5,21 @@
 #pragma once
 
 #include <openvr.h>
-#include <deque>
-#include <forward_list>
+#include <algorithm>
+#include <glm/glm.hpp>
 #include <memory>
 #include <unordered_map>
 #include <vector>
+#include "dg/FrameArena.h"
 #include "dg/FrameBuffer.h"
+#include "dg/LightClusters.h"
 #include "dg/Lights.h"
 #include "dg/RasterizerState.h"
+#include "dg/RenderGraph.h"
 #include "dg/SceneObject.h"
+#include "dg/SceneSpaceCache.h"
+#include "dg/ShadowAtlas.h"
+#include "dg/ShadowCascades.h"
 
 namespace dg {
 
@@ -24,6 +30,7 @@ namespace dg {
   class Light;
   class Shader;
   class ScreenQuadMaterial;
+  class ShaderReplacedMaterial;
 
   // Base class for a scene, which is the highest level of a front-end
   // experience for the engine.
@@ -66,16 +73,40 @@ namespace dg {
   //                                           | populating the currentRender
   //                                           | struct.
   //                                           |
-  //   if (shadow-producing light exists) {    |
-  //     SetupSubrender(Type::Depthmap)       | Sets framebuffer, also calls
-  //                                           | ClearBuffer().
+  //   (Everything up to and including         | Each step is added as a pass
+  //   PostProcess() runs as a pass of         | of renderGraph, which culls
+  //   renderGraph.)                           | passes nothing needs.
+  //                                           |
+  //   for (each shadow-casting light) {      | Static models are drawn into
+  //                                           | a cache when they or the
+  //                                           | light move, which is copied
+  //                                           | into the atlas, and then
+  //                                           | only dynamic models are
+  //                                           | drawn below.
+  //     SetupSubrender(Type::Depthmap)       | Sets framebuffer and the
+  //                                           | light's tile of the shadow
+  //                                           | atlas, and calls
+  //                                           | ClearBuffer() if uncached.
   //     PreSubrender()                        | Virtual, empty by default.
   //     DrawScene()                           |
   //     PostSubrender()                       | Virtual, empty by default.
   //     TeardownSubrender()                   |
   //   }                                       |
   //                                           |
-  //   RenderFramebuffers()                    | Virtual, empty by default.
+  //   RenderShadowCascades()                  | Draws every cascade of the
+  //                                           | first directional light in
+  //                                           | one pass, without a
+  //                                           | subrender.
+  //                                           |
+  //   for (each shadow-casting point light) { |
+  //     RenderShadowCube()                    | Draws all six faces in one
+  //                                           | pass, without a subrender.
+  //   }                                       |
+  //                                           |
+  //   AddRenderPasses()                       | Virtual, adds a pass calling
+  //     RenderFramebuffers()                  | RenderFramebuffers() by
+  //                                           | default, which is virtual and
+  //                                           | empty by default.
   //                                           |
   //   if (rendering VR) {                     |
   //                                           |
@@ -141,7 +172,7 @@ namespace dg {
             return LayerMask(lhs.value & rhs.value);
           };
           friend inline bool operator==(LayerMask lhs, LayerMask rhs) {
-            return lhs.value = rhs.value;
+            return lhs.value == rhs.value;
           };
           friend inline bool operator!(LayerMask flag) {
             return flag.value == 0;
@@ -215,6 +246,10 @@ namespace dg {
         // for window output.
         std::shared_ptr<FrameBuffer> framebuffer = nullptr;
 
+        // Region of the target to draw to and clear, as
+        // (x, y, width, height), or zero width and height for all of it.
+        glm::ivec4 viewport = glm::ivec4(0);
+
         // Camera to use, if DrawType is Scene.
         std::shared_ptr<Camera> camera = nullptr;
 
@@ -223,7 +258,9 @@ namespace dg {
         std::shared_ptr<Material> material = nullptr;
 
         // Map of shaders to replace in all materials for this subrender.
-        // Only used when drawType is Scene.
+        // Only used when drawType is Scene. If this map is modified after the
+        // subrender has already been drawn, call
+        // ClearShaderReplacementCache().
         std::unordered_map<Shader *, std::shared_ptr<Shader>>
             shaderReplacements;
 
@@ -233,6 +270,20 @@ namespace dg {
         // Which model layers to draw if DrawType is Scene.
         LayerMask layerMask = LayerMask::ALL();
 
+        enum class ModelFilter {
+          // Draw every model.
+          All,
+
+          // Draw only models with Model::isStatic set.
+          Static,
+
+          // Draw only models without Model::isStatic set.
+          Dynamic,
+        };
+
+        // Which models to draw if DrawType is Scene, besides layerMask.
+        ModelFilter modelFilter = ModelFilter::All;
+
         // Whether to send the scene's light data to the shader.
         bool sendLights = true;
 
@@ -242,6 +293,39 @@ namespace dg {
         // Whether to draw the skybox before the draw phase.
         bool renderSkybox = true;
 
+        // Returns the material to draw in place of the given material. This
+        // is the material itself, unless shaderReplacements replaces its
+        // shader, in which case it's a ShaderReplacedMaterial that is resolved
+        // once and reused for subsequent draws.
+        Material *ResolveMaterial(
+            const std::shared_ptr<Material> &material) const;
+
+        // Discards all ShaderReplacedMaterials resolved for this subrender.
+        void ClearShaderReplacementCache() const {
+          shaderReplacementCache.clear();
+        }
+
+        private:
+
+          // A material's resolved shader replacement. The entry is valid for
+          // as long as the source material still uses sourceShader, since the
+          // ShaderReplacedMaterial reads the rest of the source material's
+          // properties at draw time.
+          struct ShaderReplacement {
+            Shader *sourceShader = nullptr;
+            std::shared_ptr<ShaderReplacedMaterial> material = nullptr;
+            unsigned int lastUsedDraw = 0;
+          };
+
+          friend class Scene;
+
+          // Number of DrawScene() calls made for this subrender, used for
+          // evicting cache entries of materials no longer being drawn.
+          mutable unsigned int drawCount = 0;
+
+          mutable std::unordered_map<const Material *, ShaderReplacement>
+              shaderReplacementCache;
+
       }; // struct Subrender
 
       // Scenes may be created without any intent to run them. Do not perform
@@ -265,6 +349,36 @@ namespace dg {
       // would like the engine to automatically update it instead.
       virtual bool AutomaticWindowTitle() const;
 
+      // Returns true if Update() may run on a job while the previous frame is
+      // rendering, so that a frame takes about as long as the slower of the
+      // two rather than both. Queried once, after Initialize(). Rendered
+      // frames then show the result of the previous update.
+      //
+      // While pipelined, Update() and the behaviors it runs must:
+      //   - Add or remove children within the scene only through
+      //     Behavior::Defer(). This is asserted.
+      //   - Change render state, such as materials, lights, and camera
+      //     projections, only through Behavior::Defer(). Transforms and
+      //     enabled flags may be changed directly.
+      //   - Make graphics calls only through
+      //     JobSystem::SubmitOnMainThread(), without waiting on them. Those
+      //     tasks run in the next SynchronizePipeline().
+      virtual bool AllowsPipelinedUpdate() const {
+        return false;
+      };
+
+      // Called by the engine instead of Update() when pipelined. Runs
+      // Update() once for each of the frame's time steps, and publishes the
+      // resulting scene-space transforms for the next frame to render.
+      void UpdateSimulation();
+
+      // Called by the engine when pipelined, before rendering and while no
+      // update is running. Applies deferred changes, makes the last
+      // published update the one to render, and takes the next update's
+      // time steps. Every step of a pipelined frame therefore sees Time as
+      // of the last one.
+      void SynchronizePipeline();
+
       // Called by the Engine to set the current window, called before
       // Initialize().
       void SetWindow(std::shared_ptr<Window> window) {
@@ -281,6 +395,47 @@ namespace dg {
         SortedModel(Model &model) { this->model = &model; }
       };
 
+      // A model to draw during a subrender, recorded by RecordDrawCommands().
+      struct DrawCommand {
+        // Index into currentRender.models. Commands are recorded in sorted
+        // order, so this is also their sort key.
+        uint32_t modelIndex;
+        Model *model;
+        // Material to draw with, after the subrender's material override and
+        // shader replacements.
+        Material *material;
+      };
+
+      // Lights chosen for one draw by SelectLights(), as indices into the
+      // frame's light data, most significant first.
+      struct LightSelection {
+        uint16_t indices[Light::MAX_LIGHTS];
+        int count = 0;
+
+        friend bool operator==(const LightSelection &a,
+                               const LightSelection &b) {
+          return a.count == b.count &&
+                 std::equal(a.indices, a.indices + a.count, b.indices);
+        }
+        friend bool operator!=(const LightSelection &a,
+                               const LightSelection &b) {
+          return !(a == b);
+        }
+      };
+
+      // Most views of a layered shadow map drawn in one pass, enough for the
+      // faces of a cube.
+      //
+      // NOTE: Keep this consistent with assets/shaders/shadowlayers.g.glsl.
+      static const int MaxShadowLayers = 6;
+
+      // A shadow-casting light and its tile in the shadow atlas, which has
+      // zero size if the atlas had no room for it.
+      struct ShadowTile {
+        Light *light;
+        ShadowAtlas::Tile tile;
+      };
+
       // Hook called before any rendering work begins. This is a child scene's
       // last change to modify the scene hierarchy before it's walked.
       virtual void PreRender() {};
@@ -306,6 +461,14 @@ namespace dg {
       // frame, render it here.
       virtual void RenderFramebuffers() {};
 
+      // Hook for adding this frame's passes to the render graph, called after
+      // the shadowmap pass is added and before the main passes are. Passes
+      // whose output the main render needs should add the resources they
+      // write to currentRender.mainPassInputs, and are culled otherwise,
+      // unless they're marked with side effects. By default, adds a pass
+      // calling RenderFramebuffers().
+      virtual void AddRenderPasses(RenderGraph &graph);
+
       // Called after the main scene has been rendered to the window, but before
       // this frame's render is unable to create any more subrenders. Render
       // post-processing effects and screen-space overlays here.
@@ -319,6 +482,11 @@ namespace dg {
       // Override this to change background color.
       virtual void ClearBuffer();
 
+      // Renders every light's static shadows again next frame. Moving static
+      // models is detected, but other changes to them, such as to their
+      // meshes, need this to show up in shadows.
+      void InvalidateShadowCache();
+
       // Draws the skybox. Works for monoscopic and stereoscopic rendering.
       void DrawSkybox();
 
@@ -352,6 +520,35 @@ namespace dg {
         std::shared_ptr<Camera> vr = nullptr;
       } cameras;
 
+      // Shadows.
+      struct {
+        // Width and height of the shadow atlas that every shadow-casting
+        // light's shadow map is packed into. Ignored if the scene provides
+        // subrenders.light.framebuffer, which is then used as the atlas.
+        unsigned int atlasSize = 4096;
+
+        // How far from the main camera directional lights cast shadows.
+        float directionalDistance = 50;
+
+        // Cascaded shadow maps of the first shadow-casting directional
+        // light, up to ShadowCascades::MaxCascades of them, each
+        // cascadeResolution texels square. With no cascades, it's given a
+        // single tile of the shadow atlas like other directional lights.
+        // See ShadowCascades::Fit() for cascadeSplitBlend.
+        int cascadeCount = 4;
+        unsigned int cascadeResolution = 2048;
+        float cascadeSplitBlend = 0.75f;
+
+        // Width and height of each face of a point light's shadow cube. Up
+        // to Light::MAX_SHADOW_CUBES point lights cast shadows, those whose
+        // shadows cover the most of the screen first.
+        unsigned int cubeResolution = 512;
+
+        // Whether to keep the shadows of static models between frames. See
+        // Model::isStatic.
+        bool cacheStatic = true;
+      } shadows;
+
       // Virtual reality.
       struct {
         // True if this scene wants to attempt to use VR.
@@ -380,16 +577,119 @@ namespace dg {
         const Subrender *subrender = nullptr;
 
         // Models in scene hierarchy for current frame.
-        std::vector<SortedModel> models;
+        FrameVector<SortedModel> models;
 
         // Lights in scene hierarchy for current frame.
-        std::deque<Light *> lights;
-
-        // Pointer to the light currently casting a shadow, if any.
-        Light *shadowCastingLight = nullptr;
+        FrameVector<Light *> lights;
+
+        // Lights casting shadows this frame, and the shadow atlas holding
+        // their shadow maps once it's rendered.
+        FrameVector<Light *> shadowCastingLights;
+        std::shared_ptr<Texture> shadowMap = nullptr;
+
+        // Directional light casting cascaded shadows this frame, if any, and
+        // its cascades once they're rendered.
+        Light *cascadedLight = nullptr;
+        const ShadowCascades *shadowCascades = nullptr;
+
+        // Point lights casting shadows this frame, and their shadow cubes
+        // once they're rendered, in the same order.
+        FrameVector<Light *> shadowCubeLights;
+        std::shared_ptr<Texture> shadowCubes[Light::MAX_SHADOW_CUBES];
+
+        // Draw commands recorded by the last DrawScene(), and the subrender
+        // settings they were recorded with.
+        FrameVector<DrawCommand> drawCommands;
+        bool hasDrawCommands = false;
+        LayerMask drawCommandsLayerMask = LayerMask::ALL();
+        Subrender::ModelFilter drawCommandsModelFilter =
+            Subrender::ModelFilter::All;
+        const Material *drawCommandsMaterial = nullptr;
+
+        // Render graph resources read by the main passes, so that the passes
+        // writing them aren't culled.
+        FrameVector<RenderGraph::Resource> mainPassInputs;
 
       } currentRender;
 
+      // Passes of the current frame, rebuilt every frame in RenderFrame().
+      // Transient framebuffers created in it are kept between frames for as
+      // long as they're still used.
+      RenderGraph renderGraph;
+
+      // Allocator for bookkeeping that only lives for the current frame,
+      // such as the containers in currentRender. Reset in TeardownRender().
+      FrameArena frameArena;
+
+      // Allocator for bookkeeping within Update(), kept apart from
+      // frameArena so that updates can overlap rendering. Reset at the end
+      // of Update().
+      FrameArena updateArena;
+
+      // Whether the engine is running Update() alongside rendering. See
+      // AllowsPipelinedUpdate().
+      bool pipelined = false;
+      // Time steps taken by the last SynchronizePipeline(), for
+      // UpdateSimulation() to run.
+      int pipelinedSteps = 0;
+
+      // Lights of the current frame assigned to clusters of the view being
+      // drawn. Rebuilt in DrawScene() for every subrender that sends lights.
+      LightClusters lightClusters;
+
+      // Allocates the tiles of the shadow atlas, repacked every frame.
+      ShadowAtlas shadowAtlas;
+
+      // Cascades of currentRender.cascadedLight, refitted every frame.
+      ShadowCascades shadowCascades;
+
+      // Material drawing shadow casters into every layer of a layered
+      // shadow map at once. See DrawLayeredShadowCasters().
+      std::shared_ptr<Material> layeredCasterMaterial = nullptr;
+
+      // Shadows of static models, kept between frames in the same tiles
+      // they have in the shadow atlas. A light's tile is valid for as long
+      // as the light keeps its tile and transform, and no static model in
+      // its view moves, appears, or disappears.
+      struct {
+        struct Entry {
+          ShadowAtlas::Tile tile;
+          glm::mat4x4 lightTransform;
+          uint64_t frame = 0;
+        };
+        // Static models as they were last drawn, with their scene-space
+        // bounding spheres.
+        struct Caster {
+          glm::mat4x4 matrix;
+          glm::vec4 bounds;
+          uint64_t frame = 0;
+        };
+
+        // Acquired from the ResourcePool, and released once static shadows
+        // stop being cached.
+        std::shared_ptr<FrameBuffer> framebuffer = nullptr;
+        std::unordered_map<const Light *, Entry> lights;
+        std::unordered_map<const Model *, Caster> casters;
+        uint64_t frame = 0;
+        // Tiles whose static shadows were reused from the cache, and ones
+        // that had to be redrawn, since the scene started.
+        uint64_t reusedTiles = 0;
+        uint64_t redrawnTiles = 0;
+      } shadowCache;
+
+      // Flattened scene-space transforms of the scene hierarchy, updated in
+      // ProcessSceneHierarchy().
+      SceneSpaceCache sceneSpaceCache;
+
+      // All Models and Lights in the scene hierarchy, enabled or not, along
+      // with their slots in sceneSpaceCache. Rebuilt along with the cache
+      // when the hierarchy changes, so that collecting them each frame needs
+      // no traversal or casts.
+      struct {
+        std::vector<std::pair<Model *, int>> models;
+        std::vector<std::pair<Light *, int>> lights;
+      } registry;
+
     private:
 
       void SetupRender();
@@ -397,8 +697,29 @@ namespace dg {
       void TeardownSubrender();
       void TeardownRender();
       void DrawScene();
+      void RecordDrawCommands(const Subrender &subrender);
+      static void SelectLights(const Model &model,
+                               const FrameVector<Light::ShaderData> &lights,
+                               const FrameVector<float> &ranges,
+                               LightSelection &selection);
+      bool CanReuseDrawCommands(const Subrender &subrender) const;
       void ProcessSceneHierarchy();
-      void RenderLightShadowMap();
+      void RebuildRegistry();
+      void AddShadowPass();
+      void AddMainPasses();
+      void RenderShadowAtlas(std::shared_ptr<FrameBuffer> framebuffer);
+      void RenderStaticShadows(FrameBuffer &atlas,
+                               const FrameVector<ShadowTile> &tiles);
+      void RenderShadowCascades(FrameBuffer &framebuffer);
+      void RenderShadowCube(Light &light, int index, FrameBuffer &framebuffer);
+      // Clears a layered depth framebuffer, and draws the shadow casters
+      // into each of its count layers, seen through the layer's transform,
+      // in one pass. Casters are only sent to the layers whose view they
+      // reach.
+      void DrawLayeredShadowCasters(FrameBuffer &framebuffer,
+                                    const glm::mat4x4 *transforms, int count);
+      void SetupShadowCamera(Light &light);
+      float ShadowCoverage(const Light &light) const;
       void InitializeVR();
       void DrawHiddenAreaMesh(vr::EVREye eye);
 
@@ -7,7 +7,6 @@
 
 #include "dg/Transform.h"
 #include "dg/Behavior.h"
-#include <set>
 #include <vector>
 #include <memory>
 #include <glm/glm.hpp>
@@ -15,6 +14,8 @@
 
 namespace dg {
 
+  class SceneSpaceCache;
+
   // Represents an object within the scene tree.
   //
   // NOTE: SceneObjects cannot be moved or swapped, because they are
@@ -37,25 +38,66 @@ namespace dg {
       SceneObject& operator=(SceneObject&& other) = delete;
       virtual ~SceneObject() = default;
 
-      void AddBehavior(std::shared_ptr<Behavior> behavior);
+      // Type is the class the behavior was attached as.
+      void AddBehavior(std::shared_ptr<Behavior> behavior,
+                       Behavior::TypeID type);
+      // Updates the enabled behaviors that run on the main thread. Parallel
+      // behaviors are updated by the Scene.
       void UpdateBehaviors();
+      inline const std::vector<std::shared_ptr<Behavior>> &Behaviors() const {
+        return behaviors;
+      }
+
+      // Returns the first behavior attached as type T, or nullptr if there's
+      // none. Behaviors are found by their type ID, without casting, so a
+      // behavior attached as a subclass of T isn't found. Use
+      // GetBehaviorDerivedFrom() for that.
+      template<class T>
+      std::shared_ptr<T> GetBehavior() const {
+        int index = FindBehavior<T>();
+        return (index < 0) ? nullptr
+                           : std::static_pointer_cast<T>(behaviors[index]);
+      }
+
+      // Like GetBehavior(), without copying the shared_ptr. For hot paths;
+      // the pointer is valid for as long as this object is.
+      template<class T>
+      T *GetBehaviorPointer() const {
+        int index = FindBehavior<T>();
+        return (index < 0) ? nullptr : static_cast<T *>(behaviors[index].get());
+      }
 
+      // Returns the first behavior that is a T or a subclass of one, or
+      // nullptr if there's none. Casts each behavior, so prefer
+      // GetBehavior() when the attached type is known.
       template<class T>
-      std::shared_ptr<T> GetBehavior() {
-        for (auto iter = behaviors.begin(); iter != behaviors.end(); iter++) {
-          auto cast = std::dynamic_pointer_cast<T>(*iter);
-          if (cast != nullptr) {
-            return cast;
+      std::shared_ptr<T> GetBehaviorDerivedFrom() const {
+        for (const auto &behavior : behaviors) {
+          auto derived = std::dynamic_pointer_cast<T>(behavior);
+          if (derived != nullptr) {
+            return derived;
           }
         }
         return nullptr;
       }
 
+      // The object's transform relative to the root of its hierarchy. If
+      // the parent is part of a Scene, its scene space is read from the
+      // scene's cache rather than recomputed, so it's as of the last frame
+      // the scene rendered (or, when pipelined, the snapshot being read),
+      // and doesn't include changes to its ancestors since then.
       Transform SceneSpace() const;
+      // Sets transform so that SceneSpace() returns the given one.
       void SetSceneSpace(Transform transform);
 
+      // Computes the cached scene-space transforms of this object and its
+      // descendants. Objects in a Scene are cached by the scene every frame,
+      // so this is only needed for objects that aren't part of one.
       void CacheSceneSpace();
-      Transform CachedSceneSpace() const;
+      const Transform &CachedSceneSpace() const;
+      const glm::mat4x4 &CachedSceneSpaceMatrix() const;
+      // Transpose of the inverse of CachedSceneSpaceMatrix().
+      const glm::mat4x4 &CachedNormalMatrix() const;
 
       void AddChild(std::shared_ptr<SceneObject> child);
       void AddChild(
@@ -63,7 +105,9 @@ namespace dg {
       void RemoveChild(std::shared_ptr<SceneObject> child);
 
       SceneObject *Parent() const;
-      std::set<std::shared_ptr<SceneObject>> &Children();
+      // Children in the order they were added. Removed children may leave
+      // null entries behind, which must be skipped.
+      const std::vector<std::shared_ptr<SceneObject>> &Children() const;
 
       void LookAt(const SceneObject& object);
       void LookAtDirection(glm::vec3 direction);
@@ -74,11 +118,40 @@ namespace dg {
     private:
 
       std::vector<std::shared_ptr<Behavior>> behaviors;
+      // Type each behavior was attached as, in the same order.
+      std::vector<Behavior::TypeID> behaviorTypes;
       SceneObject *parent = nullptr;
-      std::set<std::shared_ptr<SceneObject>> children;
+      std::vector<std::shared_ptr<SceneObject>> children;
+      // Index of this object in its parent's children.
+      int childIndex = -1;
+      // Null entries in children left by removals.
+      int removedChildren = 0;
+
+      // Set while this object is part of a SceneSpaceCache, which then owns
+      // its cached transforms. Otherwise they're stored below.
+      SceneSpaceCache *sceneSpaceCache = nullptr;
+      int sceneSpaceSlot = -1;
       Transform xfCachedSceneSpace;
+      glm::mat4x4 matCachedSceneSpace = glm::mat4x4(1);
+      glm::mat4x4 matCachedNormal = glm::mat4x4(1);
 
+      template<class T>
+      int FindBehavior() const {
+        Behavior::TypeID type = Behavior::GetTypeID<T>();
+        for (size_t i = 0; i < behaviorTypes.size(); i++) {
+          if (behaviorTypes[i] == type) {
+            return (int)i;
+          }
+        }
+        return -1;
+      }
+
+      // Scene space of the parent, which must exist, as used by SceneSpace().
+      Transform ParentSceneSpace() const;
       void SetParent(SceneObject *parent, bool preserveSceneSpace);
+      void EraseChild(int index);
+
+      friend class SceneSpaceCache;
 
   }; // class SceneObject
 
@@ -0,0 +1,159 @@
+//
+//  SceneSpaceCache.h
+//
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <utility>
+#include <vector>
+#include "dg/Transform.h"
+#include "dg/TripleBuffer.h"
+
+namespace dg {
+
+  class SceneObject;
+
+  // Flattened copy of a SceneObject hierarchy's scene-space transforms.
+  //
+  // Objects are stored in contiguous arrays in hierarchy (depth-first
+  // pre-order), so every parent precedes its children and every subtree is a
+  // contiguous range. Each object knows its slot in the arrays.
+  //
+  // Update() walks the arrays and only recomputes objects whose local
+  // transform changed since the last update, or whose parent's scene-space
+  // transform changed. Subtrees are updated in parallel on the JobSystem.
+  // Since SceneObject::transform is a public field, a local change is
+  // detected by comparing against the transform seen on the previous
+  // update.
+  //
+  // Update() also computes whether each object is active, i.e. whether it
+  // and all of its ancestors (excluding the root) are enabled.
+  //
+  // Adding or removing children within the hierarchy marks the cache as
+  // stale, and it must be rebuilt before the next update.
+  //
+  // When pipelined, updates are published to a triple buffer instead of
+  // being read directly, so that one thread can update the cache while
+  // another reads the last acquired snapshot. The hierarchy's structure must
+  // not change while snapshots are being read; see SetStructureLocked().
+  class SceneSpaceCache {
+
+    public:
+
+      SceneSpaceCache() = default;
+      SceneSpaceCache(SceneSpaceCache &other) = delete;
+      SceneSpaceCache &operator=(SceneSpaceCache &other) = delete;
+      ~SceneSpaceCache();
+
+      // Re-flattens the hierarchy under root, including root itself.
+      void Rebuild(SceneObject &root);
+      void Update();
+
+      // Makes reads return the last acquired snapshot rather than the
+      // latest update.
+      void SetPipelined(bool pipelined);
+      // Copies the latest update into a new snapshot.
+      void Publish();
+      // Starts reading the newest published snapshot, if there is one.
+      // Returns whether there was one.
+      bool Acquire();
+
+      // Asserts that the hierarchy's structure doesn't change while locked.
+      inline void SetStructureLocked(bool locked) {
+        structureLocked = locked;
+      }
+
+      inline bool IsStale() const {
+        return stale;
+      }
+      inline void MarkStale() {
+        assert(!structureLocked);
+        stale = true;
+      }
+      inline size_t Size() const {
+        return objects.size();
+      }
+
+      inline SceneObject *Object(int slot) const {
+        return objects[slot];
+      }
+      inline bool IsActive(int slot) const {
+        return read.active[slot];
+      }
+      inline const Transform &SceneSpace(int slot) const {
+        return read.sceneSpaces[slot];
+      }
+      inline const glm::mat4x4 &SceneSpaceMatrix(int slot) const {
+        return read.matrices[slot];
+      }
+      inline const glm::mat4x4 &NormalMatrix(int slot) const {
+        return read.normalMatrices[slot];
+      }
+
+      // Removes the subtree under object (including object) from the cache.
+      // Its last cached transforms are copied into the objects so that they
+      // remain valid.
+      void Detach(SceneObject &object);
+
+    private:
+
+      // Subtrees with at most this many objects are updated by a single job.
+      static const int SlotsPerJob = 512;
+
+      // Per-object values that are read by the accessors above.
+      struct Snapshot {
+        // Value of rebuildCount when the snapshot was published.
+        uint64_t rebuild = 0;
+        std::vector<Transform> sceneSpaces;
+        std::vector<glm::mat4x4> matrices;
+        std::vector<glm::mat4x4> normalMatrices;
+        std::vector<uint8_t> active;
+      };
+
+      // Where the accessors read from, either the arrays below or the last
+      // acquired snapshot.
+      struct ReadPointers {
+        const Transform *sceneSpaces = nullptr;
+        const glm::mat4x4 *matrices = nullptr;
+        const glm::mat4x4 *normalMatrices = nullptr;
+        const uint8_t *active = nullptr;
+      };
+
+      void ReadFromArrays();
+
+      void Clear();
+      void Release(int slot);
+      void UpdateSlot(int slot);
+      void PartitionSubtree(int slot, const std::vector<int> &ends);
+
+      std::vector<SceneObject *> objects;
+      std::vector<int> parents;
+      std::vector<Transform> localTransforms;
+      std::vector<Transform> sceneSpaces;
+      std::vector<glm::mat4x4> matrices;
+      std::vector<glm::mat4x4> normalMatrices;
+      // Whether each object's scene-space changed during the last update.
+      std::vector<uint8_t> changed;
+      std::vector<uint8_t> active;
+      // Objects with subtrees too large for one job, in hierarchy order.
+      std::vector<int> serialSlots;
+      // [begin, end) slot ranges of whole subtrees, each updated by one job.
+      std::vector<std::pair<int, int>> parallelRanges;
+      bool stale = true;
+      // Whether every object must be recomputed on the next update.
+      bool recomputeAll = true;
+
+      // Number of rebuilds so far, to tell which snapshots match the
+      // current slots.
+      uint64_t rebuildCount = 0;
+      ReadPointers read;
+      TripleBuffer<Snapshot> snapshots;
+      bool pipelined = false;
+      bool structureLocked = false;
+
+  }; // class SceneSpaceCache
+
+} // namespace dg
@@ -42,6 +42,18 @@ namespace dg {
       static std::shared_ptr<Shader> FromFiles(const std::string& vertexPath,
                                                const std::string& geometryPath,
                                                const std::string& fragmentPath);
+      // Creates a variant of the shader with each of defines declared with
+      // #define.
+      static std::shared_ptr<Shader> FromFiles(
+          const std::string& vertexPath, const std::string& fragmentPath,
+          const std::vector<std::string>& defines);
+
+      // Shaders created by FromFiles aren't compiled until they're first
+      // used, or until this is called. This compiles all such shaders as a
+      // batch: sources are preprocessed in parallel, then every compile and
+      // link is issued before any result is waited on, so that drivers can
+      // compile them concurrently.
+      static void CompilePending();
 
       Shader() = default;
       virtual ~Shader() = default;
@@ -51,6 +63,11 @@ namespace dg {
 
       virtual void Use() = 0;
 
+      // Whether the shader declares a uniform (or constant buffer variable)
+      // that's actually used. Only meaningful once the shader is compiled,
+      // e.g. after Use().
+      virtual bool HasUniform(const std::string& name) = 0;
+
       virtual void SetBool(const std::string& name, bool value) = 0;
       virtual void SetInt(const std::string& name, int value) = 0;
       virtual void SetFloat(const std::string& name, float value) = 0;
@@ -73,6 +90,7 @@ namespace dg {
       std::string vertexPath = std::string();
       std::string geometryPath = std::string();
       std::string fragmentPath = std::string();
+      std::vector<std::string> defines;
 
   }; // class Shader
 
@@ -90,6 +108,7 @@ namespace dg {
       OpenGLShader& operator=(OpenGLShader& other) = delete;
 
       virtual void Use();
+      virtual bool HasUniform(const std::string& name);
 
       GLint GetUniformLocation(const std::string& name) const;
       GLint GetAttributeLocation(const std::string& name) const;
@@ -114,12 +133,48 @@ namespace dg {
       static std::shared_ptr<OpenGLShader> FromFiles(
           const std::string& vertexPath, const std::string& geometryPath,
           const std::string& fragmentPath);
+      static std::shared_ptr<OpenGLShader> FromFiles(
+          const std::string& vertexPath, const std::string& fragmentPath,
+          const std::vector<std::string>& defines);
+
+      static void CompilePending();
+      static void InitializeParallelCompile();
 
+      void PreprocessSources();
       void CreateProgram();
+      // Issues the compile and link without waiting for either to finish.
+      void BeginCreateProgram();
+      // Waits for the program begun by BeginCreateProgram and checks it for
+      // errors.
+      void FinishCreateProgram();
+      // Whether the pending compile and link have finished. Always true if
+      // the driver doesn't support parallel shader compilation.
+      bool IsProgramComplete() const;
       void CheckLinkErrors();
+      // Records the location of every active uniform, so that looking one
+      // up doesn't call into the driver. Called once the program is linked
+      // or loaded from the binary cache.
+      void CacheUniformLocations();
 
       GLuint programHandle = 0;
 
+      // State of a compile that's been issued but not finished.
+      std::vector<std::shared_ptr<ShaderSource>> sources;
+      uint64_t cacheKey = 0;
+      bool programPending = false;
+      // Time spent compiling and linking the program so far.
+      double compileSeconds = 0;
+
+      // Locations of the program's active uniforms, including each element
+      // of an array both as "name[i]" and, for the first, as "name".
+      std::unordered_map<std::string, GLint> uniformLocations;
+
+      // Shaders that haven't been compiled yet.
+      static std::vector<std::weak_ptr<OpenGLShader>> uncompiledShaders;
+
+      static bool parallelCompileInitialized;
+      static bool parallelCompileSupported;
+
   }; // class OpenGLShader
 
 #elif defined(_DIRECTX)
@@ -136,6 +191,7 @@ namespace dg {
       DirectXShader& operator=(DirectXShader& other) = delete;
 
       virtual void Use();
+      virtual bool HasUniform(const std::string& name);
 
       virtual void SetBool(const std::string& name, bool value);
       virtual void SetInt(const std::string& name, int value);
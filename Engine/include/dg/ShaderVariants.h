@@ -0,0 +1,48 @@
+//
+//  ShaderVariants.h
+//
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "dg/Shader.h"
+
+namespace dg {
+
+  // A family of shaders compiled from the same source files, differing only
+  // by which keywords are #defined. Keywords are identified by bit index into
+  // a keyword mask, in the order they're given to the constructor. Each
+  // variant is created the first time it's requested and compiled the first
+  // time it's used.
+  //
+  // On DirectX, shaders are precompiled, so every mask returns the same
+  // shader and keywords must instead be handled at runtime.
+  class ShaderVariants {
+
+    public:
+
+      typedef uint32_t keyword_mask;
+
+      ShaderVariants(const std::string &vertexPath,
+                     const std::string &fragmentPath,
+                     const std::vector<std::string> &keywords);
+
+      ShaderVariants(ShaderVariants &other) = delete;
+      ShaderVariants &operator=(ShaderVariants &other) = delete;
+
+      std::shared_ptr<Shader> Get(keyword_mask keywords);
+
+    private:
+
+      std::string vertexPath;
+      std::string fragmentPath;
+      std::vector<std::string> keywords;
+      std::unordered_map<keyword_mask, std::shared_ptr<Shader>> variants;
+
+  }; // class ShaderVariants
+
+} // namespace dg
@@ -0,0 +1,75 @@
+//
+//  ShadowAtlas.h
+//
+
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace dg {
+
+  // Packs the shadow maps of a frame's shadow-casting lights into square
+  // tiles of one depth texture, so that any number of lights can cast
+  // shadows while shaders bind a single shadow map.
+  //
+  // Tile sizes are powers of two, and tiles must be allocated from largest
+  // to smallest. Placing them in that order along a Z-order curve keeps each
+  // tile aligned to its own size, so the atlas fills without gaps or
+  // overlaps and packing is constant time per tile.
+  class ShadowAtlas {
+
+    public:
+
+      static const int MinTileSize = 128;
+
+      // Region of the atlas in texels, with the origin at its bottom left.
+      struct Tile {
+        int x = 0;
+        int y = 0;
+        int size = 0;
+
+        friend bool operator==(const Tile &a, const Tile &b) {
+          return a.x == b.x && a.y == b.y && a.size == b.size;
+        }
+        friend bool operator!=(const Tile &a, const Tile &b) {
+          return !(a == b);
+        }
+      };
+
+      // Frees every tile, and starts packing an atlas of the given size.
+      // Only the largest power of two square that fits is used.
+      void Reset(int width, int height);
+
+      // Allocates a tile of a power-of-two size no larger than the last one
+      // allocated. Returns false if there's no room left for it.
+      bool Allocate(int size, Tile &tile);
+
+      // Side length of the usable part of the atlas.
+      int GetSize() const;
+
+      // Largest tile a light should be given, leaving room for a few more
+      // lights at full size.
+      int GetMaxTileSize() const;
+
+      // Size of tile for a light whose shadow covers the given fraction of
+      // the screen's height, from MinTileSize up to GetMaxTileSize().
+      int TileSizeForCoverage(float coverage) const;
+
+      // The tile as (offset, scale) in texture coordinates, which is how
+      // shaders find a light's shadow map within the atlas.
+      glm::vec4 GetRect(const Tile &tile) const;
+
+    private:
+
+      int width = 0;
+      int height = 0;
+      int size = 0;
+      int lastTileSize = 0;
+      // Texels allocated so far, which is also the Z-order position of the
+      // next tile.
+      uint64_t usedArea = 0;
+
+  }; // class ShadowAtlas
+
+} // namespace dg
@@ -0,0 +1,68 @@
+//
+//  ShadowCascades.h
+//
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <memory>
+#include "dg/Camera.h"
+#include "dg/Texture.h"
+
+namespace dg {
+
+  class Light;
+
+  // Cascaded shadow maps of a directional light. The camera's view, out to
+  // a shadow distance, is split by depth into cascades that each get a
+  // shadow map of the same resolution, so that shadows near the camera get
+  // many more texels than distant ones. The shadow maps are the layers of
+  // one texture array, rendered together by Scene::RenderShadowCascades().
+  //
+  // Each cascade's shadow map covers a sphere bounding its slice of the
+  // view, which keeps its size as the camera turns, and only moves in whole
+  // texels across the light. Texels therefore land on the same spots of the
+  // scene from frame to frame, and shadow edges don't shimmer as the camera
+  // moves.
+  class ShadowCascades {
+
+    public:
+
+      // No more than Scene::MaxShadowLayers.
+      //
+      // NOTE: Keep this consistent with:
+      //       -> assets/shaders/includes/shadow_cascades.glsl.
+      static const int MaxCascades = 4;
+
+      // Fits count cascades to the camera's view from its near clip out to
+      // distance in front of it, for the light's shadow maps of resolution
+      // texels square. splitBlend blends where the view is split from evenly
+      // spaced at 0 to logarithmically spaced at 1, which gives each cascade
+      // the same texels per pixel.
+      void Fit(const Camera &camera, const Light &light, int count,
+               float distance, float splitBlend, int resolution);
+
+      int GetCount() const;
+      // Distance in front of the camera at which each cascade ends.
+      const glm::vec4 &GetSplits() const;
+      // Projection * view matrix of a cascade's shadow map.
+      const glm::mat4x4 &GetTransform(int cascade) const;
+
+      // The texture array holding each cascade's shadow map as a layer,
+      // once it's rendered.
+      void SetShadowMap(std::shared_ptr<Texture> shadowMap);
+      std::shared_ptr<Texture> GetShadowMap() const;
+
+    private:
+
+      int count = 0;
+      glm::vec4 splits = glm::vec4(0);
+      glm::mat4x4 transforms[MaxCascades];
+      std::shared_ptr<Texture> shadowMap = nullptr;
+
+      // Orthographic camera looking along the light at a cascade.
+      Camera lightCamera;
+
+  }; // class ShadowCascades
+
+} // namespace dg
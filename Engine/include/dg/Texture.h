@@ -21,6 +21,7 @@ namespace dg {
   enum class TextureType {
     _2D,
     CUBEMAP,
+    _2D_ARRAY,
   };
 
   enum class TextureFace {
@@ -69,6 +70,16 @@ namespace dg {
     bool cpuReadable = false;
     unsigned int width;
     unsigned int height;
+    // Number of images in a _2D_ARRAY texture.
+    unsigned int layers = 1;
+
+    // Approximate GPU memory used by a texture with these options.
+    size_t EstimatedMemorySize() const;
+
+    friend bool operator==(const TextureOptions &a, const TextureOptions &b);
+    friend bool operator!=(const TextureOptions &a, const TextureOptions &b) {
+      return !(a == b);
+    }
 
 #if defined(_OPENGL)
     GLenum GetOpenGLTarget() const;
@@ -0,0 +1,74 @@
+//
+//  TripleBuffer.h
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace dg {
+
+  // Lock-free handoff of values from one producer thread to one consumer
+  // thread.
+  //
+  // The producer fills WriteBuffer() and calls Publish(), and the consumer
+  // calls Acquire() and reads ReadBuffer(). Neither ever waits on the other:
+  // the third buffer sits between them, holding the latest published value
+  // until the consumer takes it or the producer replaces it. Values the
+  // consumer never acquires are skipped.
+  //
+  // Buffers are reused rather than reconstructed, so containers inside T
+  // keep their capacity from one handoff to the next.
+  template <typename T>
+  class TripleBuffer {
+
+    public:
+
+      TripleBuffer() = default;
+      TripleBuffer(TripleBuffer &other) = delete;
+      TripleBuffer &operator=(TripleBuffer &other) = delete;
+
+      // Only accessed by the producer.
+      inline T &WriteBuffer() {
+        return buffers[write];
+      }
+
+      // Makes the write buffer the latest value, and starts writing to the
+      // buffer it replaces.
+      void Publish() {
+        uint8_t previous =
+            middle.exchange(write | FreshBit, std::memory_order_acq_rel);
+        write = previous & IndexMask;
+      }
+
+      // Takes the latest published value if there's a new one. Returns
+      // whether ReadBuffer() changed.
+      bool Acquire() {
+        if ((middle.load(std::memory_order_relaxed) & FreshBit) == 0) {
+          return false;
+        }
+        uint8_t previous = middle.exchange(read, std::memory_order_acq_rel);
+        read = previous & IndexMask;
+        return true;
+      }
+
+      // Only accessed by the consumer.
+      inline const T &ReadBuffer() const {
+        return buffers[read];
+      }
+
+    private:
+
+      static const uint8_t IndexMask = 0x3;
+      // Set in middle while it holds a value the consumer hasn't acquired.
+      static const uint8_t FreshBit = 0x4;
+
+      T buffers[3];
+      uint8_t write = 0;
+      std::atomic<uint8_t> middle{1};
+      uint8_t read = 2;
+
+  }; // class TripleBuffer
+
+} // namespace dg
@@ -20,6 +20,7 @@ namespace dg {
       RotateBehavior(float speed, glm::vec3 axis = UP);
 
       virtual void Update();
+      virtual UpdateAccess GetUpdateAccess() const;
 
     private:
 
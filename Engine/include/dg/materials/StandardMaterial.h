@@ -6,6 +6,7 @@
 #include <memory>
 #include "dg/Material.h"
 #include "dg/Shader.h"
+#include "dg/ShaderVariants.h"
 #include "dg/Texture.h"
 
 namespace dg {
@@ -48,6 +49,15 @@ namespace dg {
 
     private:
 
+      // Shader keywords, selected by the setters. Their order must match
+      // the keyword names given to the ShaderVariants.
+      enum class Keyword : ShaderVariants::keyword_mask {
+        LIT          = 1 << 0,
+        DIFFUSE_MAP  = 1 << 1,
+        SPECULAR_MAP = 1 << 2,
+        NORMAL_MAP   = 1 << 3,
+      };
+
       enum class TexUnitHints {
         DIFFUSE = (int)Material::TexUnitHints::END,
         SPECULAR,
@@ -56,7 +66,13 @@ namespace dg {
         END,
       };
 
-      static std::shared_ptr<Shader> standardShader;
+      static ShaderVariants &GetShaderVariants();
+
+      void SetKeyword(Keyword keyword, bool enabled);
+
+      static std::unique_ptr<ShaderVariants> shaderVariants;
+
+      ShaderVariants::keyword_mask keywords = 0;
 
   }; // class Material
 
@@ -0,0 +1,105 @@
+//
+//  opengl/ProgramBinaryCache.h
+//
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "dg/opengl/ShaderSource.h"
+#include "dg/opengl/glad/glad.h"
+
+namespace dg {
+
+  // Caches linked shader program binaries on disk so that subsequent launches
+  // can skip compiling and linking. Programs are keyed on their fully
+  // preprocessed sources and the driver's vendor, renderer, and version.
+  //
+  // Requires GL_ARB_get_program_binary (core in OpenGL 4.1). If the driver
+  // doesn't support any binary formats, the cache is silently disabled.
+  class ProgramBinaryCache {
+
+    public:
+
+      struct Statistics {
+        int hits = 0;
+        int misses = 0;
+        // Cached binaries that the driver refused to load, e.g. after a
+        // driver update.
+        int rejected = 0;
+        // Time spent compiling and linking programs that weren't cached.
+        double compileSeconds = 0;
+        // Time spent loading programs from the cache.
+        double loadSeconds = 0;
+        // Compile and link time the cache hits originally took.
+        double savedCompileSeconds = 0;
+      };
+
+      static const std::string CacheDirectory;
+
+      static bool IsSupported();
+
+      // Returns a key identifying a program linked from these sources.
+      static uint64_t KeyForSources(
+          const std::vector<std::shared_ptr<ShaderSource>> &sources);
+
+      // Creates a linked program from the cached binary for key. Returns 0 if
+      // there is no usable binary, in which case the caller must compile and
+      // link the program itself.
+      static GLuint Load(uint64_t key);
+
+      // Must be called on a program before it's linked for its binary to be
+      // retrievable by Store().
+      static void PrepareProgram(GLuint program);
+
+      // Writes the binary of a successfully linked program to the cache.
+      static void Store(uint64_t key, GLuint program, double compileSeconds);
+
+      static const Statistics &GetStatistics() {
+        return statistics;
+      }
+      static void ReportStatistics(std::ostream &os);
+
+    private:
+
+      typedef void(APIENTRYP GetProgramBinaryProc)(GLuint program,
+                                                   GLsizei bufSize,
+                                                   GLsizei *length,
+                                                   GLenum *binaryFormat,
+                                                   void *binary);
+      typedef void(APIENTRYP ProgramBinaryProc)(GLuint program,
+                                                GLenum binaryFormat,
+                                                const void *binary,
+                                                GLsizei length);
+      typedef void(APIENTRYP ProgramParameteriProc)(GLuint program,
+                                                    GLenum pname, GLint value);
+
+      struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t binaryFormat;
+        uint32_t binaryLength;
+        double compileSeconds;
+      };
+
+      static const uint32_t FileMagic;
+      static const uint32_t FileVersion;
+
+      static void Initialize();
+      static std::string PathForKey(uint64_t key);
+
+      static bool initialized;
+      static bool supported;
+      static uint64_t driverKey;
+      static GetProgramBinaryProc getProgramBinary;
+      static ProgramBinaryProc programBinary;
+      static ProgramParameteriProc programParameteri;
+      static Statistics statistics;
+
+  }; // class ProgramBinaryCache
+
+} // namespace dg
@@ -18,14 +18,32 @@ namespace dg {
 
     public:
 
+      // Preprocesses and compiles the shader at path.
       static std::shared_ptr<ShaderSource> FromFile(GLenum type,
                                                     const std::string& path);
+      // Preprocesses the shader at path without compiling it. Call Compile()
+      // before attaching it to a program.
+      static std::shared_ptr<ShaderSource> Preprocess(GLenum type,
+                                                      const std::string& path);
+      static std::shared_ptr<ShaderSource> Preprocess(
+          GLenum type, const std::string& path,
+          const std::vector<std::string>& defines);
 
       ShaderSource() = default;
       ShaderSource(ShaderSource& other) = delete;
       ~ShaderSource();
       ShaderSource& operator=(ShaderSource& other) = delete;
 
+      // Compiles and checks for errors.
+      void Compile();
+      // Issues the compile without waiting for it to finish. Call
+      // CheckCompileErrors() once the result is needed.
+      void BeginCompile();
+      void CheckCompileErrors();
+
+      inline GLenum GetType() const {
+        return shaderType;
+      }
       inline GLuint GetHandle() const {
         return shaderHandle;
       }
@@ -38,9 +56,6 @@ namespace dg {
 
     private:
 
-      void CompileShader();
-      void CheckCompileErrors();
-
       std::shared_ptr<Preprocessor> file;
 
       GLenum shaderType = 0;
@@ -71,7 +71,8 @@ namespace dg {
       static vr::EVRControllerAxisType GetAxisType(Axis axis);
       void ResetState();
 
-      std::weak_ptr<VRTrackedObject> trackedObject;
+      // Behavior on the same SceneObject, so it lives as long as this one.
+      VRTrackedObject *trackedObject = nullptr;
 
       unsigned int lastPacketNum = 0;
 
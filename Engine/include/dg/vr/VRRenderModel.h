@@ -26,7 +26,8 @@ namespace dg {
       void DestroyRenderModel();
       void LoadRenderModel(const std::string& modelName);
 
-      std::weak_ptr<VRTrackedObject> trackedObject;
+      // Behavior on the same SceneObject, so it lives as long as this one.
+      VRTrackedObject *trackedObject = nullptr;
       int deviceIndex = -1;
       std::string currentModelName;
       std::weak_ptr<Model> model;
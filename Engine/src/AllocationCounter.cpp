@@ -0,0 +1,55 @@
+//
+//  AllocationCounter.cpp
+//
+
+#include "dg/AllocationCounter.h"
+
+#if defined(DG_COUNT_ALLOCATIONS)
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+  std::atomic<uint64_t> allocationCount(0);
+
+} // namespace
+
+// The default array and nothrow forms all forward to these.
+void *operator new(size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  void *ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+bool dg::AllocationCounter::IsEnabled() {
+  return true;
+}
+
+uint64_t dg::AllocationCounter::Count() {
+  return allocationCount.load(std::memory_order_relaxed);
+}
+
+#else
+
+bool dg::AllocationCounter::IsEnabled() {
+  return false;
+}
+
+uint64_t dg::AllocationCounter::Count() {
+  return 0;
+}
+
+#endif
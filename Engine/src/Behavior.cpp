@@ -6,16 +6,19 @@
 #include <stdexcept>
 #include "dg/SceneObject.h"
 
+std::mutex dg::Behavior::deferredMutex;
+std::vector<std::function<void()>> dg::Behavior::deferredCommands;
+
 void dg::Behavior::Attach_Impl(
     std::shared_ptr<dg::SceneObject> object,
-    std::shared_ptr<dg::Behavior> behavior) {
+    std::shared_ptr<dg::Behavior> behavior, TypeID type) {
   if (behavior->sceneObject.lock() != nullptr) {
     throw std::runtime_error(
         "Attempted to attach an already-attached Behavior with a SceneObject.");
   }
 
   behavior->sceneObject = object;
-  object->AddBehavior(behavior);
+  object->AddBehavior(behavior, type);
   behavior->Initialize();
 }
 
@@ -30,3 +33,26 @@ std::shared_ptr<dg::SceneObject> dg::Behavior::GetSceneObject() const {
   return sceneObject.lock();
 }
 
+
+void dg::Behavior::Defer(std::function<void()> command) {
+  std::lock_guard<std::mutex> lock(deferredMutex);
+  deferredCommands.push_back(std::move(command));
+}
+
+void dg::Behavior::RunDeferred() {
+  // Commands may defer more commands, which then run in the same call.
+  std::vector<std::function<void()>> commands;
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(deferredMutex);
+      if (deferredCommands.empty()) {
+        return;
+      }
+      commands.swap(deferredCommands);
+    }
+    for (auto &command : commands) {
+      command();
+    }
+    commands.clear();
+  }
+}
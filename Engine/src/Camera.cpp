@@ -4,6 +4,8 @@
 
 #include "dg/Camera.h"
 
+#include <algorithm>
+#include <cmath>
 #include <glm/gtc/matrix_transform.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtc/constants.hpp>
@@ -61,3 +63,32 @@ glm::mat4x4 dg::Camera::GetProjectionMatrix(vr::EVREye eye) const {
   return OVR2GLM(
     vr::VRSystem()->GetProjectionMatrix(eye, nearClip, farClip));
 }
+
+void dg::Camera::BoundView(float nearDistance, float farDistance,
+                           glm::vec3 &center, float &radius) const {
+  // Find the corners of the view between the two distances.
+  glm::vec3 corners[8];
+  for (int i = 0; i < 8; i++) {
+    float distance = (i < 4) ? nearDistance : farDistance;
+    glm::vec2 halfSize;
+    if (projection == Projection::Orthographic) {
+      halfSize = glm::vec2(orthoWidth, orthoHeight) * 0.5f;
+    } else {
+      float halfHeight = distance * std::tan(fov / 2);
+      halfSize = glm::vec2(halfHeight * aspectRatio, halfHeight);
+    }
+    corners[i] = glm::vec3(CachedSceneSpaceMatrix() *
+                           glm::vec4((i & 1) ? halfSize.x : -halfSize.x,
+                                     (i & 2) ? halfSize.y : -halfSize.y,
+                                     -distance, 1));
+  }
+
+  center = glm::vec3(0);
+  for (const glm::vec3 &corner : corners) {
+    center += corner / 8.f;
+  }
+  radius = 0;
+  for (const glm::vec3 &corner : corners) {
+    radius = std::max(radius, glm::distance(center, corner));
+  }
+}
@@ -3,10 +3,21 @@
 //
 
 #include "dg/Engine.h"
+#include <exception>
+#include <iomanip>
+#include "dg/AllocationCounter.h"
+#include "dg/JobSystem.h"
+#include "dg/ResourcePool.h"
 #include "dg/Scene.h"
+#include "dg/Shader.h"
 #include "dg/Utils.h"
 #include "dg/Window.h"
 
+#if defined(_OPENGL)
+#include <iostream>
+#include "dg/opengl/ProgramBinaryCache.h"
+#endif
+
 #if defined(__APPLE__)
 #include <mach-o/dyld.h>
 #include <unistd.h>
@@ -21,12 +32,16 @@ dg::BaseEngine::BaseEngine(std::shared_ptr<Window> window) : window(window) {
 }
 
 dg::BaseEngine::~BaseEngine() {
+  // Main-thread tasks may still use graphics resources, so stop jobs first.
+  JobSystem::Shutdown();
+  ResourcePool::Shutdown();
   Graphics::Shutdown();
   instance = nullptr;
 }
 
 void dg::BaseEngine::Initialize() {
   FixCurrentDirectory();
+  JobSystem::Initialize();
 
   try {
     Graphics::Initialize(*window);
@@ -34,6 +49,7 @@ void dg::BaseEngine::Initialize() {
     throw std::runtime_error("Failed to initialize graphics: " +
                              std::string(e.what()));
   }
+  ResourcePool::Initialize();
 }
 
 void dg::BaseEngine::StartScene(std::shared_ptr<Scene> scene) {
@@ -52,11 +68,24 @@ void dg::BaseEngine::Update() {
   dg::Time::Update();
   window->PollEvents();
 
-  try {
-    scene->Update();
-  } catch (const EngineError &e) {
-    throw std::runtime_error("Failed to update scene: " +
-                             std::string(e.what()));
+  if (pipelined) {
+    // Hand the update that ran during the last frame to rendering.
+    scene->SynchronizePipeline();
+  } else {
+    auto updateStart = std::chrono::steady_clock::now();
+    try {
+      while (dg::Time::Step()) {
+        scene->Update();
+      }
+    } catch (const EngineError &e) {
+      throw std::runtime_error("Failed to update scene: " +
+                               std::string(e.what()));
+    }
+
+    // Run continuations of background work that must happen on this thread,
+    // such as uploading loaded assets to the GPU.
+    JobSystem::RunMainThreadTasks();
+    updateTime = std::chrono::steady_clock::now() - updateStart;
   }
 
   // Handle escape key to release cursor or quit app.
@@ -78,15 +107,49 @@ void dg::BaseEngine::Update() {
 
   UpdateWindowTitle();
 
+  // When pipelined, update the next frame on a worker while this one
+  // renders. It runs in the background, so that the main thread doesn't
+  // pick it up while waiting on rendering jobs.
+  JobSystem::TaskHandle simulation = nullptr;
+  if (pipelined) {
+    simulation = JobSystem::SubmitInBackground([this]() {
+      auto updateStart = std::chrono::steady_clock::now();
+      scene->UpdateSimulation();
+      updateTime = std::chrono::steady_clock::now() - updateStart;
+    });
+  }
+
   // Render.
+  std::exception_ptr renderError = nullptr;
+  auto renderStart = std::chrono::steady_clock::now();
   window->StartRender();
   try {
+    uint64_t allocationsBefore = AllocationCounter::Count();
     scene->RenderFrame();
+    CheckFrameAllocations(AllocationCounter::Count() - allocationsBefore);
   } catch (const EngineError &e) {
-    throw std::runtime_error("Failed to render scene: " +
-                             std::string(e.what()));
+    renderError = std::make_exception_ptr(std::runtime_error(
+        "Failed to render scene: " + std::string(e.what())));
+  }
+  renderTime = std::chrono::steady_clock::now() - renderStart;
+
+  // The update must finish before the scene can be touched again, even if
+  // rendering failed.
+  if (simulation != nullptr) {
+    try {
+      JobSystem::Wait(simulation);
+    } catch (const EngineError &e) {
+      throw std::runtime_error("Failed to update scene: " +
+                               std::string(e.what()));
+    }
+  }
+  if (renderError != nullptr) {
+    std::rethrow_exception(renderError);
   }
   window->FinishRender();
+
+  // Free pooled render targets that haven't been used in a while.
+  ResourcePool::EndFrame();
 }
 
 void dg::BaseEngine::UpdateWindowTitle() {
@@ -97,12 +160,18 @@ void dg::BaseEngine::UpdateWindowTitle() {
   }
 
   if (scene->AutomaticWindowTitle()) {
+    Time::FrameStatistics stats = Time::GetFrameStatistics();
     window->SetTitle(
         ((std::ostringstream &)(std::ostringstream()
                                 << "Drew Graphics | " << Graphics::GetAPIName()
-                                << " | " << (int)(1.0 / dg::Time::Delta)
+                                << " | " << (int)(1.0 / dg::Time::FrameDelta)
                                 << " FPS | " << dg::Time::AverageFrameRate
-                                << " average FPS"))
+                                << " average FPS | " << std::setprecision(3)
+                                << stats.p99 * 1000 << " ms p99 | "
+                                << stats.max * 1000 << " ms max | "
+                                << updateTime.count() * 1000 << " ms update"
+                                << (pipelined ? " (pipelined) | " : " | ")
+                                << renderTime.count() * 1000 << " ms render"))
             .str());
   }
   lastWindowUpdateTime = dg::Time::Elapsed;
@@ -131,14 +200,42 @@ void dg::BaseEngine::StartNextScene() {
   try {
     scene->SetWindow(window);
     scene->Initialize();
+
+    // Compile the scene's shaders as a batch rather than one at a time as
+    // they're first used.
+    Shader::CompilePending();
   } catch (const EngineError& e) {
     throw std::runtime_error("Failed to initialize scene: " +
                              std::string(e.what()));
   }
 
+  pipelined = scene->AllowsPipelinedUpdate();
+
+#if defined(_OPENGL)
+  ProgramBinaryCache::ReportStatistics(std::cout);
+#endif
+
   // Set up timing.
   dg::Time::Reset();
   lastWindowUpdateTime = 0;
+  sceneFrames = 0;
+  reportedFrameAllocations = false;
+}
+
+void dg::BaseEngine::CheckFrameAllocations(uint64_t allocations) {
+  // By now, the scene has compiled its shaders, filled the resource pool,
+  // and grown its frame arena, so rendering shouldn't allocate anymore.
+  const uint64_t warmupFrames = 10;
+  sceneFrames++;
+  // A pipelined update allocating on a worker would be counted too.
+  if (!AllocationCounter::IsEnabled() || pipelined ||
+      sceneFrames <= warmupFrames || reportedFrameAllocations ||
+      allocations == 0) {
+    return;
+  }
+  reportedFrameAllocations = true;
+  std::cerr << "Warning: Rendering frame " << sceneFrames << " made "
+            << allocations << " heap allocations." << std::endl;
 }
 
 void dg::BaseEngine::FixCurrentDirectory() {
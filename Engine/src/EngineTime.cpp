@@ -3,6 +3,8 @@
 //
 
 #include "dg/EngineTime.h"
+#include <algorithm>
+#include <cmath>
 
 #if defined(_OPENGL)
 #include "dg/opengl/glad/glad.h"
@@ -14,15 +16,37 @@
 
 double dg::Time::Elapsed = 0;
 double dg::Time::Delta = 0;
+double dg::Time::FrameDelta = 0;
 double dg::Time::FrameNumber = 1;
 double dg::Time::AverageFrameRate = -1;
+double dg::Time::FixedDelta = 1.0 / 60.0;
+int dg::Time::MaxStepsPerFrame = 5;
+double dg::Time::Alpha = 1;
+dg::Time::Mode dg::Time::mode = dg::Time::Mode::Variable;
+double dg::Time::lastRealTime = 0;
+double dg::Time::accumulator = 0;
+int dg::Time::pendingSteps = 0;
+double dg::Time::stepDelta = 0;
+float dg::Time::frameTimes[FrameWindow];
+int dg::Time::frameTimeCount = 0;
+int dg::Time::nextFrameTime = 0;
+double dg::Time::frameTimeSum = 0;
+uint16_t dg::Time::histogram[HistogramBuckets];
 #if defined(_DIRECTX)
 double dg::Time::perfCounterSeconds;
 __int64 dg::Time::startTime;
-__int64 dg::Time::currentTime;
-__int64 dg::Time::previousTime;
 #endif
 
+void dg::Time::SetMode(Mode mode) {
+  Time::mode = mode;
+  accumulator = 0;
+  Alpha = 1;
+}
+
+dg::Time::Mode dg::Time::GetMode() {
+  return mode;
+}
+
 void dg::Time::Reset() {
 #if defined(_OPENGL)
   glfwSetTime(0);
@@ -30,35 +54,116 @@ void dg::Time::Reset() {
   __int64 perfFreq;
   QueryPerformanceFrequency((LARGE_INTEGER*)&perfFreq);
   perfCounterSeconds = 1.0 / (double)perfFreq;
+  QueryPerformanceCounter((LARGE_INTEGER*)&startTime);
+#endif
+
+  Elapsed = 0;
+  lastRealTime = 0;
+  accumulator = 0;
+  pendingSteps = 0;
+  frameTimeCount = 0;
+  nextFrameTime = 0;
+  frameTimeSum = 0;
+  std::fill(histogram, histogram + HistogramBuckets, 0);
+}
 
+double dg::Time::RealTime() {
+#if defined(_OPENGL)
+  return glfwGetTime();
+#elif defined(_DIRECTX)
   __int64 now;
   QueryPerformanceCounter((LARGE_INTEGER*)&now);
-  startTime = now;
-  currentTime = now;
-  previousTime = now;
+  return (double)(now - startTime) * perfCounterSeconds;
 #endif
 }
 
 void dg::Time::Update() {
+  double now = RealTime();
+  FrameDelta = std::max(now - lastRealTime, 0.0);
+  lastRealTime = now;
+  RecordFrameTime(FrameDelta);
 
-#if defined(_OPENGL)
-  double oldElapsed = Elapsed;
-  Elapsed = glfwGetTime();
-  Delta = Elapsed - oldElapsed;
-#elif defined(_DIRECTX)
-  QueryPerformanceCounter((LARGE_INTEGER*)&currentTime);
-  Delta = max(((double)(currentTime - previousTime) * perfCounterSeconds), 0.0);
-  Elapsed = ((double)(currentTime - startTime) * perfCounterSeconds);
-  previousTime = currentTime;
-#endif
+  switch (mode) {
+    case Mode::Variable:
+      pendingSteps = 1;
+      stepDelta = FrameDelta;
+      Alpha = 1;
+      break;
+    case Mode::FixedStep:
+      accumulator = std::min(accumulator + FrameDelta,
+                             FixedDelta * MaxStepsPerFrame);
+      pendingSteps = (int)(accumulator / FixedDelta);
+      stepDelta = FixedDelta;
+      Alpha = (accumulator - pendingSteps * FixedDelta) / FixedDelta;
+      break;
+    case Mode::Deterministic:
+      pendingSteps = 1;
+      stepDelta = FixedDelta;
+      Alpha = 1;
+      break;
+  }
+
+  AverageFrameRate = frameTimeCount / frameTimeSum;
+  FrameNumber++;
+}
+
+bool dg::Time::Step() {
+  if (pendingSteps == 0) {
+    return false;
+  }
+  pendingSteps--;
+  if (mode == Mode::FixedStep) {
+    accumulator -= FixedDelta;
+  }
+  Delta = stepDelta;
+  Elapsed += Delta;
+  return true;
+}
+
+void dg::Time::RecordFrameTime(double frameTime) {
+  auto bucket = [](double time) {
+    return std::min((int)(time / HistogramBucketWidth), HistogramBuckets - 1);
+  };
 
-  double fps = 1.0 / Delta;
-  if (FrameNumber < 60) { // Don't start averaging framerate immediately.
-    AverageFrameRate = fps;
+  if (frameTimeCount == FrameWindow) {
+    float oldest = frameTimes[nextFrameTime];
+    frameTimeSum -= oldest;
+    histogram[bucket(oldest)]--;
   } else {
-    AverageFrameRate = (AverageFrameRate * (FrameNumber - 1) / FrameNumber)
-                     + (fps / FrameNumber);
+    frameTimeCount++;
   }
-  FrameNumber++;
+  frameTimes[nextFrameTime] = (float)frameTime;
+  frameTimeSum += (float)frameTime;
+  histogram[bucket((float)frameTime)]++;
+  nextFrameTime = (nextFrameTime + 1) % FrameWindow;
 }
 
+dg::Time::FrameStatistics dg::Time::GetFrameStatistics() {
+  FrameStatistics statistics;
+  statistics.frames = frameTimeCount;
+  if (frameTimeCount == 0) {
+    return statistics;
+  }
+
+  statistics.average = frameTimeSum / frameTimeCount;
+  for (int i = 0; i < frameTimeCount; i++) {
+    statistics.max = std::max(statistics.max, (double)frameTimes[i]);
+  }
+
+  // Walk the histogram for each percentile, reporting the upper edge of the
+  // bucket it falls in. The last bucket is unbounded, so use the max.
+  const double percentiles[] = {0.50, 0.95, 0.99};
+  double *results[] = {&statistics.p50, &statistics.p95, &statistics.p99};
+  int cumulative = 0;
+  int percentile = 0;
+  for (int i = 0; i < HistogramBuckets && percentile < 3; i++) {
+    cumulative += histogram[i];
+    while (percentile < 3 &&
+           cumulative >= std::ceil(percentiles[percentile] * frameTimeCount)) {
+      *results[percentile] =
+          std::min((i + 1) * HistogramBucketWidth, statistics.max);
+      percentile++;
+    }
+  }
+  return statistics;
+}
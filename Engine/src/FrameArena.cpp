@@ -0,0 +1,59 @@
+//
+//  FrameArena.cpp
+//
+
+#include "dg/FrameArena.h"
+#include <algorithm>
+#include <cstdint>
+
+dg::FrameArena::FrameArena(size_t capacity) {
+  AddBlock(std::max(capacity, (size_t)1));
+}
+
+void dg::FrameArena::AddBlock(size_t size) {
+  Block block;
+  block.data = std::unique_ptr<unsigned char[]>(new unsigned char[size]);
+  block.size = size;
+  blocks.push_back(std::move(block));
+  offset = 0;
+}
+
+void *dg::FrameArena::Allocate(size_t size, size_t alignment) {
+  assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+  Block *block = &blocks.back();
+  uintptr_t base = (uintptr_t)block->data.get();
+  uintptr_t aligned = (base + offset + alignment - 1) & ~(alignment - 1);
+  if (aligned + size > base + block->size) {
+    // Grow geometrically so that a frame that keeps outgrowing the arena
+    // only adds a logarithmic number of blocks.
+    AddBlock(std::max(size + alignment, block->size * 2));
+    block = &blocks.back();
+    base = (uintptr_t)block->data.get();
+    aligned = (base + alignment - 1) & ~(alignment - 1);
+  }
+
+  size_t newOffset = (size_t)(aligned - base) + size;
+  used += newOffset - offset;
+  offset = newOffset;
+  return (void *)aligned;
+}
+
+void dg::FrameArena::Reset() {
+  if (blocks.size() > 1) {
+    // Coalesce into a single block that fits everything this frame used.
+    size_t capacity = Capacity();
+    blocks.clear();
+    AddBlock(capacity);
+  }
+  offset = 0;
+  used = 0;
+}
+
+size_t dg::FrameArena::Capacity() const {
+  size_t capacity = 0;
+  for (const Block &block : blocks) {
+    capacity += block.size;
+  }
+  return capacity;
+}
@@ -17,22 +17,25 @@ std::shared_ptr<dg::FrameBuffer> dg::BaseFrameBuffer::Create(Options options) {
 
 dg::BaseFrameBuffer::BaseFrameBuffer(Options options) : options(options) {
   // Ensure all textures are the same type.
-  TextureType type = options.textureOptions.empty()
-                         ? TextureType::_2D
-                         : options.textureOptions[0].type;
+  TextureType type = options.type;
   for (auto &texOpts : options.textureOptions) {
     if (texOpts.type != type) {
       throw EngineError(
-          "Framebuffer::Options::textureOptions have inconsistent "
-          "TextureTypes.");
+          "Framebuffer::Options::textureOptions have TextureTypes "
+          "inconsistent with Framebuffer::Options::type.");
     }
   }
+  if (options.layers != 1 && type != TextureType::_2D_ARRAY) {
+    throw EngineError(
+        "Only framebuffers with _2D_ARRAY textures can have multiple layers.");
+  }
 
   // Create depth (and possibly stencil) texture.
   TextureOptions depthTexOpts;
   depthTexOpts.type = type;
   depthTexOpts.width = options.width;
   depthTexOpts.height = options.height;
+  depthTexOpts.layers = options.layers;
   depthTexOpts.format = options.hasStencil ? TexturePixelFormat::DEPTH_STENCIL
                                       : TexturePixelFormat::DEPTH;
   depthTexOpts.pixelType =
@@ -45,8 +48,10 @@ dg::BaseFrameBuffer::BaseFrameBuffer(Options options) : options(options) {
   // one color texture definition, create a standard one.
   if (options.hasColor && options.textureOptions.empty()) {
     TextureOptions texOpts;
+    texOpts.type = type;
     texOpts.width = options.width;
     texOpts.height = options.height;
+    texOpts.layers = options.layers;
     texOpts.wrap = TextureWrap::CLAMP_EDGE;
     options.textureOptions.push_back(texOpts);
   }
@@ -54,15 +59,44 @@ dg::BaseFrameBuffer::BaseFrameBuffer(Options options) : options(options) {
 
   // Create color texture(s).
   for (const auto &texOpts : options.textureOptions) {
-    if (texOpts.width != options.width || texOpts.height != options.height) {
+    if (texOpts.width != options.width || texOpts.height != options.height ||
+        texOpts.layers != options.layers) {
       throw EngineError(
           "Attempted to create a framebuffer color texture with dimensions "
-          "that do not match those of the framebuffer.");
+          "or layers that do not match those of the framebuffer.");
     }
     colorTextures.push_back(Texture::Generate(texOpts));
   }
 }
 
+size_t dg::BaseFrameBuffer::Options::EstimatedMemorySize() const {
+  // Depth is always 32 bits per pixel, either 24-bit depth with an 8-bit
+  // stencil, or 32-bit float depth.
+  size_t images = 1;
+  if (type == TextureType::CUBEMAP) {
+    images = 6;
+  } else if (type == TextureType::_2D_ARRAY) {
+    images = layers;
+  }
+  size_t size = (size_t)width * height * 4 * images;
+  if (hasColor && textureOptions.empty()) {
+    size += (size_t)width * height * 4 * images;
+  }
+  for (const auto &texOpts : textureOptions) {
+    size += texOpts.EstimatedMemorySize();
+  }
+  return size;
+}
+
+bool dg::operator==(const BaseFrameBuffer::Options &a,
+                    const BaseFrameBuffer::Options &b) {
+  return a.width == b.width && a.height == b.height &&
+         a.depthReadable == b.depthReadable && a.hasColor == b.hasColor &&
+         a.hasStencil == b.hasStencil && a.type == b.type &&
+         a.layers == b.layers &&
+         a.textureOptions == b.textureOptions;
+}
+
 const dg::FrameBuffer::Options &dg::BaseFrameBuffer::GetOptions() const {
   return options;
 }
@@ -109,6 +143,7 @@ dg::OpenGLFrameBuffer::OpenGLFrameBuffer(Options options)
                                GL_TEXTURE_2D, tex->GetHandle(), 0);
         break;
       case TextureType::CUBEMAP:
+      case TextureType::_2D_ARRAY:
         glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i,
                              tex->GetHandle(), 0);
         break;
@@ -121,7 +156,9 @@ dg::OpenGLFrameBuffer::OpenGLFrameBuffer(Options options)
     case TextureType::_2D:
       glFramebufferTexture2D(GL_FRAMEBUFFER, format, GL_TEXTURE_2D,
                              depthTexture->GetHandle(), 0);
+      break;
     case TextureType::CUBEMAP:
+    case TextureType::_2D_ARRAY:
       glFramebufferTexture(GL_FRAMEBUFFER, format, depthTexture->GetHandle(),
                            0);
       break;
@@ -159,6 +196,10 @@ dg::DirectXFrameBuffer::DirectXFrameBuffer(Options options)
     throw EngineError(
         "TODO: Multiple color textures not yet implemented for DirectX build.");
   }
+  if (options.layers > 1) {
+    throw EngineError(
+        "TODO: Layered framebuffers not yet implemented for DirectX build.");
+  }
 
   if (options.hasColor) {
     Graphics::Instance->device->CreateRenderTargetView(
@@ -32,40 +32,76 @@ void dg::Graphics::InitializeResources() {
 }
 
 void dg::Graphics::PushRasterizerState(const RasterizerState &state) {
-  if (states.empty()) {
-    states.push_front(
-        std::unique_ptr<RasterizerState>(new RasterizerState(state)));
-  } else {
-    states.push_front(std::unique_ptr<RasterizerState>(
-        new RasterizerState(*states.front() + state)));
+  if (rasterizerStateDepth >= MAX_RASTERIZER_STATE_DEPTH) {
+    throw EngineError("Exceeded maximum RasterizerState stack depth of " +
+                      std::to_string(MAX_RASTERIZER_STATE_DEPTH));
+  }
+
+  if (rasterizerStateDepth == 0) {
+    rasterizerStates[rasterizerStateDepth++] = state;
+    return;
   }
+
+  const RasterizerState &parent = rasterizerStates[rasterizerStateDepth - 1];
+  RasterizerState::hash_type key = parent.GetHash();
+  std::hash_combine(key, state.GetHash());
+
+  auto iter = flattenedRasterizerStates.find(key);
+  if (iter != flattenedRasterizerStates.end()) {
+    if (iter->second.parent == parent && iter->second.child == state) {
+      rasterizerStates[rasterizerStateDepth++] = iter->second.flattened;
+      return;
+    }
+
+    // Hash collision. Flatten without caching.
+    rasterizerStates[rasterizerStateDepth] = parent + state;
+    rasterizerStateDepth++;
+    return;
+  }
+
+  FlattenedRasterizerState entry;
+  entry.parent = parent;
+  entry.child = state;
+  entry.flattened = parent + state;
+  rasterizerStates[rasterizerStateDepth++] = entry.flattened;
+  flattenedRasterizerStates.emplace(key, entry);
 }
 
 void dg::Graphics::PopRasterizerState() {
-  states.pop_front();
+  assert(rasterizerStateDepth > 0);
+  rasterizerStateDepth--;
 }
 
 void dg::Graphics::ApplyCurrentRasterizerState() {
-  if (states.empty()) {
+  if (rasterizerStateDepth == 0) {
     return;
   }
 
-  auto &state = *states.front();
+  auto &state = rasterizerStates[rasterizerStateDepth - 1];
 
-#define STATE_ATTRIBUTE(index, attr_type, public_name, member_name) \
-  if (!state.Declares##public_name()) { \
-    throw UndeclaredRasterizerStateAttribute(#public_name); \
+  if (hasAppliedRasterizerState && state == appliedRasterizerState) {
+    return;
   }
+
+  if (!state.DeclaresAllAttributes()) {
+#define STATE_ATTRIBUTE(index, attr_type, public_name, member_name) \
+    if (!state.Declares##public_name()) { \
+      throw UndeclaredRasterizerStateAttribute(#public_name); \
+    }
 #include "dg/RasterizerStateAttributes.def"
+  }
 
-  ApplyRasterizerState(state);
+  ApplyRasterizerState(
+      state, hasAppliedRasterizerState ? &appliedRasterizerState : nullptr);
+  appliedRasterizerState = state;
+  hasAppliedRasterizerState = true;
 }
 
 const dg::RasterizerState *dg::Graphics::GetEffectiveRasterizerState() const {
-  if (states.empty()) {
+  if (rasterizerStateDepth == 0) {
     return &emptyRasterizerState;
   } else {
-    return states.front().get();
+    return &rasterizerStates[rasterizerStateDepth - 1];
   }
 }
 
@@ -134,9 +170,10 @@ void dg::OpenGLGraphics::ClearColor(glm::vec3 color, bool clearDepth,
   if (clearDepth || clearStencil) {
     glEnable(GL_DEPTH_TEST);
     glDepthMask(GL_TRUE);
+    InvalidateAppliedRasterizerState();
   }
   glClearColor(color.x, color.y, color.z, 1);
-  glClear(clearBits);
+  ClearWithin(clearRegion, clearBits);
 }
 
 void dg::OpenGLGraphics::ClearDepthStencil(bool clearDepth, bool clearStencil) {
@@ -153,46 +190,108 @@ void dg::OpenGLGraphics::ClearDepthStencil(bool clearDepth, bool clearStencil) {
   if (clearDepth || clearStencil) {
     glEnable(GL_DEPTH_TEST);
     glDepthMask(GL_TRUE);
+    InvalidateAppliedRasterizerState();
+  }
+  ClearWithin(clearRegion, clearBits);
+}
+
+void dg::OpenGLGraphics::ClearWithin(const glm::ivec4 &region,
+                                     GLbitfield clearBits) {
+  // The scissor test is only enabled around the clear, since rasterizer
+  // states don't track it.
+  bool scissor = region.z > 0 && region.w > 0;
+  if (scissor) {
+    glScissor(region.x, region.y, region.z, region.w);
+    glEnable(GL_SCISSOR_TEST);
   }
   glClear(clearBits);
+  if (scissor) {
+    glDisable(GL_SCISSOR_TEST);
+  }
 }
 
-void dg::OpenGLGraphics::ApplyRasterizerState(const RasterizerState &state) {
+void dg::OpenGLGraphics::CopyFrameBuffer(FrameBuffer &source,
+                                         FrameBuffer &destination) {
+  assert(source.GetOptions() == destination.GetOptions());
+  GLbitfield mask = GL_DEPTH_BUFFER_BIT;
+  if (source.GetOptions().hasColor) {
+    mask |= GL_COLOR_BUFFER_BIT;
+  }
+  if (source.GetOptions().hasStencil) {
+    mask |= GL_STENCIL_BUFFER_BIT;
+  }
+  GLint width = (GLint)source.GetWidth();
+  GLint height = (GLint)source.GetHeight();
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, source.GetHandle());
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, destination.GetHandle());
+  glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, mask,
+                    GL_NEAREST);
+  SetRenderTarget(destination);
+}
+
+void dg::OpenGLGraphics::ApplyRasterizerState(
+    const RasterizerState &state, const RasterizerState *previous) {
   auto cullMode = state.GetCullMode();
-  switch (cullMode) {
-    case RasterizerState::CullMode::OFF:
-      glDisable(GL_CULL_FACE);
-      break;
-    case RasterizerState::CullMode::FRONT:
-    case RasterizerState::CullMode::BACK:
-      glEnable(GL_CULL_FACE);
-      glCullFace(ToGLEnum(cullMode));
-      break;
+  if (previous == nullptr || previous->GetCullMode() != cullMode) {
+    switch (cullMode) {
+      case RasterizerState::CullMode::OFF:
+        glDisable(GL_CULL_FACE);
+        break;
+      case RasterizerState::CullMode::FRONT:
+      case RasterizerState::CullMode::BACK:
+        glEnable(GL_CULL_FACE);
+        glCullFace(ToGLEnum(cullMode));
+        break;
+    }
   }
 
   bool writeDepth = state.GetWriteDepth();
   auto depthFunc = state.GetDepthFunc();
-  if (!writeDepth && depthFunc == RasterizerState::DepthFunc::ALWAYS) {
-    glDisable(GL_DEPTH_TEST);
-  } else {
-    glEnable(GL_DEPTH_TEST);
-    glDepthMask(writeDepth ? GL_TRUE : GL_FALSE);
-    glDepthFunc(ToGLEnum(depthFunc));
+  if (previous == nullptr || previous->GetWriteDepth() != writeDepth ||
+      previous->GetDepthFunc() != depthFunc) {
+    if (!writeDepth && depthFunc == RasterizerState::DepthFunc::ALWAYS) {
+      glDisable(GL_DEPTH_TEST);
+    } else {
+      glEnable(GL_DEPTH_TEST);
+      glDepthMask(writeDepth ? GL_TRUE : GL_FALSE);
+      glDepthFunc(ToGLEnum(depthFunc));
+    }
   }
 
-  if (state.GetBlendEnabled()) {
-    glEnable(GL_BLEND);
-    glBlendEquationSeparate(ToGLEnum(state.GetRGBBlendEquation()),
-                            ToGLEnum(state.GetAlphaBlendEquation()));
-    glBlendFuncSeparate(ToGLEnum(state.GetSrcRGBBlendFunc()),
-                        ToGLEnum(state.GetDstRGBBlendFunc()),
-                        ToGLEnum(state.GetSrcAlphaBlendFunc()),
-                        ToGLEnum(state.GetDstAlphaBlendFunc()));
-  } else {
-    glDisable(GL_BLEND);
+  bool blendEnabled = state.GetBlendEnabled();
+  if (previous == nullptr || previous->GetBlendEnabled() != blendEnabled) {
+    if (blendEnabled) {
+      glEnable(GL_BLEND);
+    } else {
+      glDisable(GL_BLEND);
+    }
+  }
+  if (blendEnabled) {
+    // Blend parameters are only applied while blending is on, so the
+    // previous state's may never have reached GL.
+    bool blendApplied = previous != nullptr && previous->GetBlendEnabled();
+    if (!blendApplied ||
+        previous->GetRGBBlendEquation() != state.GetRGBBlendEquation() ||
+        previous->GetAlphaBlendEquation() != state.GetAlphaBlendEquation()) {
+      glBlendEquationSeparate(ToGLEnum(state.GetRGBBlendEquation()),
+                              ToGLEnum(state.GetAlphaBlendEquation()));
+    }
+    if (!blendApplied ||
+        previous->GetSrcRGBBlendFunc() != state.GetSrcRGBBlendFunc() ||
+        previous->GetDstRGBBlendFunc() != state.GetDstRGBBlendFunc() ||
+        previous->GetSrcAlphaBlendFunc() != state.GetSrcAlphaBlendFunc() ||
+        previous->GetDstAlphaBlendFunc() != state.GetDstAlphaBlendFunc()) {
+      glBlendFuncSeparate(ToGLEnum(state.GetSrcRGBBlendFunc()),
+                          ToGLEnum(state.GetDstRGBBlendFunc()),
+                          ToGLEnum(state.GetSrcAlphaBlendFunc()),
+                          ToGLEnum(state.GetDstAlphaBlendFunc()));
+    }
   }
 
-  glPolygonMode(GL_FRONT_AND_BACK, ToGLEnum(state.GetFillMode()));
+  auto fillMode = state.GetFillMode();
+  if (previous == nullptr || previous->GetFillMode() != fillMode) {
+    glPolygonMode(GL_FRONT_AND_BACK, ToGLEnum(fillMode));
+  }
 }
 
 GLenum dg::OpenGLGraphics::ToGLEnum(RasterizerState::CullMode cullMode) {
@@ -476,9 +575,33 @@ void dg::DirectXGraphics::ClearDepthStencil(bool clearDepth,
                                  0);
 }
 
-
-void dg::DirectXGraphics::ApplyRasterizerState(const RasterizerState &state) {
-  auto hash = std::hash<RasterizerState>{}(state);
+void dg::DirectXGraphics::CopyFrameBuffer(FrameBuffer &source,
+                                          FrameBuffer &destination) {
+  assert(source.GetOptions() == destination.GetOptions());
+  ID3D11Resource *sourceResource;
+  ID3D11Resource *destinationResource;
+  source.GetDepthStencilView()->GetResource(&sourceResource);
+  destination.GetDepthStencilView()->GetResource(&destinationResource);
+  context->CopyResource(destinationResource, sourceResource);
+  sourceResource->Release();
+  destinationResource->Release();
+  if (source.GetOptions().hasColor) {
+    source.GetRenderTargetView()->GetResource(&sourceResource);
+    destination.GetRenderTargetView()->GetResource(&destinationResource);
+    context->CopyResource(destinationResource, sourceResource);
+    sourceResource->Release();
+    destinationResource->Release();
+  }
+  SetRenderTarget(destination);
+}
+
+
+void dg::DirectXGraphics::ApplyRasterizerState(
+    const RasterizerState &state, const RasterizerState *previous) {
+  // D3D11 state objects are immutable, so there's nothing to diff. The
+  // redundant-state check in ApplyCurrentRasterizerState already skips
+  // rebinding identical states.
+  auto hash = state.GetHash();
   auto stateResourcesIter = rasterizerStateResources.find(hash);
   RasterizerStateResources *stateResourcesPtr;
   if (stateResourcesIter != rasterizerStateResources.end()) {
@@ -0,0 +1,567 @@
+//
+//  JobSystem.cpp
+//
+
+#include "dg/JobSystem.h"
+#include <algorithm>
+#include <cassert>
+
+std::unique_ptr<dg::JobSystem> dg::JobSystem::Instance = nullptr;
+
+namespace {
+
+  // Index of the current thread's worker, or -1 for threads that aren't part
+  // of the job system. The main thread is worker 0.
+  thread_local int currentWorker = -1;
+
+  // State shared by the jobs of a single ParallelFor().
+  struct Loop {
+    dg::JobSystem::RangeFunction fn;
+    const void *context;
+    size_t count;
+    size_t grainSize;
+    std::atomic<size_t> next{0};
+    // Helper jobs that haven't finished yet.
+    std::atomic<int> activeJobs{0};
+    std::mutex exceptionMutex;
+    std::exception_ptr exception;
+  };
+
+  void RunChunks(Loop &loop) {
+    while (true) {
+      size_t begin = loop.next.fetch_add(loop.grainSize);
+      if (begin >= loop.count) {
+        return;
+      }
+      try {
+        loop.fn(loop.context, begin,
+                std::min(begin + loop.grainSize, loop.count));
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(loop.exceptionMutex);
+        if (loop.exception == nullptr) {
+          loop.exception = std::current_exception();
+        }
+        // Skip the remaining chunks.
+        loop.next = loop.count;
+      }
+    }
+  }
+
+} // namespace
+
+#pragma region Work Queue
+
+// Double-ended queue of jobs. The owning thread pushes and pops at the
+// bottom, and other threads steal from the top, so that the owner works on
+// its most recent (cache-warm) jobs while thieves take the oldest, which
+// tend to be the largest.
+class dg::JobSystem::WorkQueue {
+
+  public:
+
+    void Push(const Job &job) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (count == ring.size()) {
+        Grow();
+      }
+      ring[(head + count) % ring.size()] = job;
+      count++;
+    }
+
+    bool Pop(Job &job) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (count == 0) {
+        return false;
+      }
+      count--;
+      job = ring[(head + count) % ring.size()];
+      return true;
+    }
+
+    bool Steal(Job &job) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (count == 0) {
+        return false;
+      }
+      job = ring[head];
+      head = (head + 1) % ring.size();
+      count--;
+      return true;
+    }
+
+  private:
+
+    void Grow() {
+      std::vector<Job> grown(ring.size() * 2);
+      for (size_t i = 0; i < count; i++) {
+        grown[i] = ring[(head + i) % ring.size()];
+      }
+      ring.swap(grown);
+      head = 0;
+    }
+
+    std::mutex mutex;
+    std::vector<Job> ring = std::vector<Job>(256);
+    size_t head = 0;
+    size_t count = 0;
+
+}; // class WorkQueue
+
+struct dg::JobSystem::Worker {
+  WorkQueue queue;
+  std::atomic<uint64_t> jobsExecuted{0};
+  std::atomic<uint64_t> jobsStolen{0};
+  std::atomic<uint64_t> busyNanoseconds{0};
+  // State for picking steal victims.
+  uint32_t random = 0;
+};
+
+#pragma endregion
+#pragma region Lifecycle
+
+void dg::JobSystem::Initialize(int threadCount) {
+  assert(Instance == nullptr);
+  if (threadCount <= 0) {
+    threadCount = std::max((int)std::thread::hardware_concurrency(), 1);
+  }
+  Instance = std::unique_ptr<JobSystem>(new JobSystem(threadCount));
+}
+
+void dg::JobSystem::Shutdown() {
+  // Stop while Instance is still set, since finishing the remaining tasks
+  // schedules their dependents through it.
+  if (Instance != nullptr) {
+    Instance->Stop();
+  }
+  Instance = nullptr;
+}
+
+dg::JobSystem::JobSystem(int threadCount) {
+  mainThreadID = std::this_thread::get_id();
+  currentWorker = 0;
+  sharedQueue = std::unique_ptr<WorkQueue>(new WorkQueue());
+  backgroundQueue = std::unique_ptr<WorkQueue>(new WorkQueue());
+  for (int i = 0; i < threadCount; i++) {
+    workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    workers.back()->random = 0x9E3779B9u * (i + 1);
+  }
+  statisticsStart = std::chrono::steady_clock::now();
+  for (int i = 1; i < threadCount; i++) {
+    threads.emplace_back([this, i]() { WorkerLoop(i); });
+  }
+}
+
+dg::JobSystem::~JobSystem() {
+  Stop();
+  currentWorker = -1;
+}
+
+void dg::JobSystem::Stop() {
+  if (stopped) {
+    return;
+  }
+  stopped = true;
+
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    quit = true;
+  }
+  wake.notify_all();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+
+  // Finish whatever is still queued on this thread, including anything the
+  // remaining tasks schedule, so that no task is left unfinished.
+  while (true) {
+    if (TryRunJob()) {
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mainThreadMutex);
+      if (mainThreadTasks.empty()) {
+        break;
+      }
+    }
+    RunMainThreadTasksInternal();
+  }
+}
+
+void dg::JobSystem::WorkerLoop(int index) {
+  currentWorker = index;
+  while (true) {
+    if (TryRunJob()) {
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    sleepingWorkers++;
+    wake.wait(lock, [this]() { return quit || queuedJobs > 0; });
+    sleepingWorkers--;
+    if (quit) {
+      return;
+    }
+  }
+}
+
+#pragma endregion
+#pragma region Scheduling
+
+void dg::JobSystem::Push(const Job &job, bool background) {
+  if (background) {
+    backgroundQueue->Push(job);
+  } else if (currentWorker >= 0) {
+    workers[currentWorker]->queue.Push(job);
+  } else {
+    sharedQueue->Push(job);
+  }
+  queuedJobs++;
+
+  // A worker going to sleep increments sleepingWorkers before checking
+  // queuedJobs, so either it sees this job or this sees it sleeping.
+  if (sleepingWorkers > 0) {
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    wake.notify_one();
+  }
+}
+
+bool dg::JobSystem::TrySteal(int thief, Job &job) {
+  int workerCount = (int)workers.size();
+  uint32_t random = 0;
+  if (thief >= 0) {
+    // xorshift32
+    random = workers[thief]->random;
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    workers[thief]->random = random;
+  }
+
+  for (int i = 0; i < workerCount; i++) {
+    int victim = (int)((random + i) % workerCount);
+    if (victim != thief && workers[victim]->queue.Steal(job)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool dg::JobSystem::TryRunJob() {
+  int index = currentWorker;
+  Job job;
+  bool stolen = false;
+  // The main thread only takes background jobs when there's no one else.
+  bool takesBackground = index != 0 || threads.empty();
+  if (index >= 0 && workers[index]->queue.Pop(job)) {
+  } else if (sharedQueue->Steal(job)) {
+  } else if (takesBackground && backgroundQueue->Steal(job)) {
+  } else if (TrySteal(index, job)) {
+    stolen = true;
+  } else {
+    return false;
+  }
+  queuedJobs--;
+  Execute(job, index, stolen);
+  return true;
+}
+
+void dg::JobSystem::Execute(const Job &job, int workerIndex, bool stolen) {
+  auto startTime = std::chrono::steady_clock::now();
+  job.execute(job.data);
+  if (workerIndex < 0) {
+    return;
+  }
+
+  auto duration = std::chrono::steady_clock::now() - startTime;
+  Worker &worker = *workers[workerIndex];
+  worker.jobsExecuted.fetch_add(1, std::memory_order_relaxed);
+  if (stolen) {
+    worker.jobsStolen.fetch_add(1, std::memory_order_relaxed);
+  }
+  worker.busyNanoseconds.fetch_add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(),
+      std::memory_order_relaxed);
+}
+
+template <typename Predicate>
+void dg::JobSystem::HelpUntil(const Predicate &done, bool runMainThreadTasks) {
+  bool mainThread = (std::this_thread::get_id() == mainThreadID);
+  while (!done()) {
+    if (TryRunJob()) {
+      continue;
+    }
+    if (mainThread && runMainThreadTasks) {
+      RunMainThreadTasksInternal();
+    }
+    std::this_thread::yield();
+  }
+}
+
+#pragma endregion
+#pragma region Tasks
+
+dg::JobSystem::TaskHandle dg::JobSystem::CreateTask(
+    std::function<void()> fn, const std::vector<TaskHandle> &dependencies,
+    TaskGroup *group, bool mainThread, bool background) {
+  auto task = std::make_shared<Task>();
+  task->fn = std::move(fn);
+  task->group = group;
+  task->mainThread = mainThread;
+  task->background = background;
+  if (group != nullptr) {
+    group->pending++;
+    if (mainThread) {
+      group->pendingMainThread++;
+    }
+  }
+
+  if (Instance == nullptr) {
+    // Without worker threads, dependencies have always already finished.
+    RunTaskJob(task.get());
+    return task;
+  }
+
+  for (const TaskHandle &dependency : dependencies) {
+    std::lock_guard<std::mutex> lock(dependency->mutex);
+    if (!dependency->IsFinished()) {
+      task->remaining++;
+      dependency->dependents.push_back(task);
+    }
+  }
+  if (--task->remaining == 0) {
+    Instance->Schedule(task);
+  }
+  return task;
+}
+
+void dg::JobSystem::Schedule(const TaskHandle &task) {
+  if (task->mainThread) {
+    std::lock_guard<std::mutex> lock(mainThreadMutex);
+    mainThreadTasks.push_back(task);
+    return;
+  }
+
+  task->self = task;
+  Push(Job{RunTaskJob, task.get()}, task->background);
+}
+
+void dg::JobSystem::RunTaskJob(void *data) {
+  Task &task = *(Task *)data;
+  // Hold on to the task until it's done, now that it's out of the queue.
+  TaskHandle keepAlive = std::move(task.self);
+
+  try {
+    task.fn();
+  } catch (...) {
+    task.exception = std::current_exception();
+    if (task.group != nullptr) {
+      std::lock_guard<std::mutex> lock(task.group->exceptionMutex);
+      if (task.group->exception == nullptr) {
+        task.group->exception = task.exception;
+      }
+    }
+  }
+  FinishTask(task);
+}
+
+void dg::JobSystem::FinishTask(Task &task) {
+  // Release anything captured by the function.
+  task.fn = nullptr;
+
+  std::vector<TaskHandle> dependents;
+  {
+    std::lock_guard<std::mutex> lock(task.mutex);
+    task.finished.store(true, std::memory_order_release);
+    dependents.swap(task.dependents);
+  }
+  for (const TaskHandle &dependent : dependents) {
+    if (--dependent->remaining == 0) {
+      Instance->Schedule(dependent);
+    }
+  }
+
+  // Must come last, since the group may be destroyed as soon as its pending
+  // count reaches zero.
+  if (task.group != nullptr) {
+    if (task.mainThread) {
+      task.group->pendingMainThread--;
+    }
+    task.group->pending--;
+  }
+}
+
+dg::JobSystem::TaskHandle dg::JobSystem::Submit(
+    std::function<void()> fn, const std::vector<TaskHandle> &dependencies) {
+  return CreateTask(std::move(fn), dependencies, nullptr, false);
+}
+
+dg::JobSystem::TaskHandle dg::JobSystem::SubmitOnMainThread(
+    std::function<void()> fn, const std::vector<TaskHandle> &dependencies) {
+  return CreateTask(std::move(fn), dependencies, nullptr, true);
+}
+
+dg::JobSystem::TaskHandle dg::JobSystem::SubmitInBackground(
+    std::function<void()> fn, const std::vector<TaskHandle> &dependencies) {
+  return CreateTask(std::move(fn), dependencies, nullptr, false, true);
+}
+
+void dg::JobSystem::Wait(const TaskHandle &task) {
+  if (Instance != nullptr) {
+    Instance->HelpUntil([&]() { return task->IsFinished(); },
+                        task->mainThread);
+  }
+  if (task->exception != nullptr) {
+    std::rethrow_exception(task->exception);
+  }
+}
+
+void dg::JobSystem::RunMainThreadTasks() {
+  if (Instance != nullptr) {
+    assert(std::this_thread::get_id() == Instance->mainThreadID);
+    Instance->RunMainThreadTasksInternal();
+  }
+}
+
+void dg::JobSystem::RunMainThreadTasksInternal() {
+  // Take the tasks out first, since running them may schedule more.
+  std::vector<TaskHandle> tasks;
+  {
+    std::lock_guard<std::mutex> lock(mainThreadMutex);
+    tasks.swap(mainThreadTasks);
+  }
+  for (const TaskHandle &task : tasks) {
+    auto startTime = std::chrono::steady_clock::now();
+    RunTaskJob(task.get());
+    auto duration = std::chrono::steady_clock::now() - startTime;
+    workers[0]->jobsExecuted.fetch_add(1, std::memory_order_relaxed);
+    workers[0]->busyNanoseconds.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+            .count(),
+        std::memory_order_relaxed);
+  }
+}
+
+dg::JobSystem::TaskGroup::~TaskGroup() {
+  try {
+    Wait();
+  } catch (...) {
+    // Exceptions are only reported by an explicit Wait().
+  }
+}
+
+dg::JobSystem::TaskHandle dg::JobSystem::TaskGroup::Run(
+    std::function<void()> fn, const std::vector<TaskHandle> &dependencies) {
+  return CreateTask(std::move(fn), dependencies, this, false);
+}
+
+dg::JobSystem::TaskHandle dg::JobSystem::TaskGroup::RunOnMainThread(
+    std::function<void()> fn, const std::vector<TaskHandle> &dependencies) {
+  return CreateTask(std::move(fn), dependencies, this, true);
+}
+
+void dg::JobSystem::TaskGroup::Wait() {
+  if (Instance != nullptr) {
+    Instance->HelpUntil([this]() { return pending == 0; },
+                        pendingMainThread > 0);
+  }
+
+  std::exception_ptr thrown;
+  {
+    std::lock_guard<std::mutex> lock(exceptionMutex);
+    thrown = exception;
+    exception = nullptr;
+  }
+  if (thrown != nullptr) {
+    std::rethrow_exception(thrown);
+  }
+}
+
+#pragma endregion
+#pragma region Parallel For
+
+void dg::JobSystem::Run(size_t count, size_t grainSize, RangeFunction fn,
+                        const void *context) {
+  if (count == 0) {
+    return;
+  }
+  grainSize = std::max(grainSize, (size_t)1);
+  if (count <= grainSize || Instance == nullptr ||
+      Instance->workers.size() < 2) {
+    fn(context, 0, count);
+    return;
+  }
+
+  Loop loop;
+  loop.fn = fn;
+  loop.context = context;
+  loop.count = count;
+  loop.grainSize = grainSize;
+
+  // One helper job per other thread, at most one per remaining chunk. Each
+  // job keeps taking chunks until there are none left.
+  size_t chunks = (count + grainSize - 1) / grainSize;
+  int helpers = (int)std::min(chunks - 1, Instance->workers.size() - 1);
+  loop.activeJobs = helpers;
+  for (int i = 0; i < helpers; i++) {
+    Instance->Push(Job{RunLoopJob, &loop});
+  }
+
+  RunChunks(loop);
+  // The helper jobs reference the loop, so wait for all of them to finish,
+  // even those that found no chunks left.
+  Instance->HelpUntil([&]() { return loop.activeJobs == 0; }, false);
+
+  if (loop.exception != nullptr) {
+    std::rethrow_exception(loop.exception);
+  }
+}
+
+void dg::JobSystem::RunLoopJob(void *data) {
+  Loop &loop = *(Loop *)data;
+  RunChunks(loop);
+  loop.activeJobs--;
+}
+
+#pragma endregion
+#pragma region Statistics
+
+int dg::JobSystem::ThreadCount() {
+  return (Instance == nullptr) ? 1 : (int)Instance->workers.size();
+}
+
+std::vector<dg::JobSystem::WorkerStatistics> dg::JobSystem::GetStatistics() {
+  std::vector<WorkerStatistics> statistics;
+  if (Instance == nullptr) {
+    return statistics;
+  }
+
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - Instance->statisticsStart;
+  for (auto &worker : Instance->workers) {
+    WorkerStatistics stats;
+    stats.jobsExecuted = worker->jobsExecuted.load(std::memory_order_relaxed);
+    stats.jobsStolen = worker->jobsStolen.load(std::memory_order_relaxed);
+    stats.busySeconds =
+        worker->busyNanoseconds.load(std::memory_order_relaxed) / 1e9;
+    if (elapsed.count() > 0) {
+      stats.utilization = stats.busySeconds / elapsed.count();
+    }
+    statistics.push_back(stats);
+  }
+  return statistics;
+}
+
+void dg::JobSystem::ResetStatistics() {
+  if (Instance == nullptr) {
+    return;
+  }
+  for (auto &worker : Instance->workers) {
+    worker->jobsExecuted = 0;
+    worker->jobsStolen = 0;
+    worker->busyNanoseconds = 0;
+  }
+  Instance->statisticsStart = std::chrono::steady_clock::now();
+}
+
+#pragma endregion
@@ -0,0 +1,293 @@
+//
+//  LightClusters.cpp
+//
+
+#include "dg/LightClusters.h"
+#include <algorithm>
+#include <cmath>
+#include "dg/JobSystem.h"
+
+dg::LightClusters::~LightClusters() {
+#if defined(_OPENGL)
+  if (buffers[0] != 0) {
+    glDeleteTextures(3, textures);
+    glDeleteBuffers(3, buffers);
+  }
+#endif
+}
+
+void dg::LightClusters::Build(const FrameVector<Light::ShaderData> &lights,
+                              const glm::mat4x4 &view,
+                              const glm::mat4x4 &projection) {
+  lightData.clear();
+  grid.clear();
+  indices.clear();
+  spheres.x.clear();
+  spheres.y.clear();
+  spheres.depth.clear();
+  spheres.radius.clear();
+  spheres.index.clear();
+
+  bool perspective = projection[2][3] == -1 && projection[3][3] == 0;
+
+  // Global lights go first, so that local lights' indices come after them.
+  // Indices are 16 bits, so any lights past that are dropped.
+  size_t count = std::min(lights.size(), (size_t)UINT16_MAX);
+  globalLightCount = 0;
+  for (size_t i = 0; i < count; i++) {
+    float range = Light::Range(lights[i]);
+    if (lights[i].type != Light::LightType::NONE && range > 0 &&
+        (!perspective || std::isinf(range))) {
+      PackLight(lights[i]);
+      globalLightCount++;
+    }
+  }
+  for (size_t i = 0; i < count; i++) {
+    float range = Light::Range(lights[i]);
+    if (lights[i].type != Light::LightType::NONE && range > 0 &&
+        perspective && !std::isinf(range)) {
+      glm::vec4 center = view * glm::vec4(lights[i].position, 1);
+      spheres.x.push_back(center.x);
+      spheres.y.push_back(center.y);
+      spheres.depth.push_back(-center.z);
+      spheres.radius.push_back(range);
+      spheres.index.push_back((uint16_t)(lightData.size() / LightDataTexels));
+      PackLight(lights[i]);
+    }
+  }
+
+  if (spheres.index.empty()) {
+    dimensions = glm::ivec3(1);
+    depthScale = 0;
+    depthBias = 0;
+    grid.push_back(glm::uvec2(0));
+    Upload();
+    return;
+  }
+
+  // Recover the clip planes from the projection. An infinite far plane
+  // gets a finite one, past which the last slice extends.
+  dimensions = glm::ivec3(TilesX, TilesY, Slices);
+  nearDepth = projection[3][2] / (projection[2][2] - 1);
+  if (std::abs(projection[2][2] + 1) > 1e-6f) {
+    farDepth = projection[3][2] / (projection[2][2] + 1);
+  } else {
+    farDepth = nearDepth * 10000;
+  }
+  depthScale = Slices / std::log(farDepth / nearDepth);
+  depthBias = -std::log(nearDepth) * depthScale;
+
+  slices.resize(Slices);
+  JobSystem::ParallelFor(Slices, 1, [&](size_t begin, size_t end) {
+    for (size_t slice = begin; slice < end; slice++) {
+      AssignSlice((int)slice, projection);
+    }
+  });
+
+  // Concatenate the slices' lists, in the same cluster order as the grid.
+  const int tilesPerSlice = TilesX * TilesY;
+  grid.resize(tilesPerSlice * Slices);
+  uint32_t offset = 0;
+  for (int slice = 0; slice < Slices; slice++) {
+    const SliceScratch &scratch = slices[slice];
+    for (int tile = 0; tile < tilesPerSlice; tile++) {
+      grid[slice * tilesPerSlice + tile] =
+          glm::uvec2(offset, scratch.counts[tile]);
+      offset += scratch.counts[tile];
+    }
+    indices.insert(indices.end(), scratch.indices.begin(),
+                   scratch.indices.end());
+  }
+
+  Upload();
+}
+
+void dg::LightClusters::AssignSlice(int slice,
+                                    const glm::mat4x4 &projection) {
+  SliceScratch &scratch = slices[slice];
+  const int tilesPerSlice = TilesX * TilesY;
+  std::fill(scratch.counts, scratch.counts + tilesPerSlice, 0);
+  scratch.pairs.clear();
+  scratch.indices.clear();
+
+  float sliceNear = std::exp((slice - depthBias) / depthScale);
+  float sliceFar = std::exp((slice + 1 - depthBias) / depthScale);
+  if (slice == 0) {
+    sliceNear = nearDepth;
+  }
+  if (slice == Slices - 1) {
+    sliceFar = farDepth;
+  }
+
+  // Find the lights overlapping the slice's depths. The comparisons are
+  // kept free of branches so that they vectorize.
+  size_t count = spheres.depth.size();
+  const float *depths = spheres.depth.data();
+  const float *radii = spheres.radius.data();
+  scratch.candidates.resize(count);
+  size_t candidateCount = 0;
+  for (size_t i = 0; i < count; i++) {
+    bool overlaps = (depths[i] + radii[i] > sliceNear) &
+                    (depths[i] - radii[i] < sliceFar);
+    scratch.candidates[candidateCount] = (uint16_t)i;
+    candidateCount += overlaps ? 1 : 0;
+  }
+
+  // A view-space point (x, y, d) projects to NDC x = x * P00 / d - P20, so
+  // tile edges are lines through the eye with slope (ndc + P20) / P00.
+  float p00 = projection[0][0];
+  float p11 = projection[1][1];
+  float p20 = projection[2][0];
+  float p21 = projection[2][1];
+  float slopesX[TilesX + 1];
+  float slopesY[TilesY + 1];
+  for (int i = 0; i <= TilesX; i++) {
+    slopesX[i] = (-1.0f + 2.0f * i / TilesX + p20) / p00;
+  }
+  for (int i = 0; i <= TilesY; i++) {
+    slopesY[i] = (-1.0f + 2.0f * i / TilesY + p21) / p11;
+  }
+  auto tileX = [&](float slope) {
+    return std::clamp((int)std::floor((slope * p00 - p20 + 1) * 0.5f * TilesX),
+                      0, TilesX - 1);
+  };
+  auto tileY = [&](float slope) {
+    return std::clamp((int)std::floor((slope * p11 - p21 + 1) * 0.5f * TilesY),
+                      0, TilesY - 1);
+  };
+
+  for (size_t c = 0; c < candidateCount; c++) {
+    uint16_t i = scratch.candidates[c];
+    float x = spheres.x[i];
+    float y = spheres.y[i];
+    float depth = spheres.depth[i];
+    float radius = spheres.radius[i];
+
+    // Narrow the tiles down to those under the sphere's bounding box, clipped
+    // to the slice. Its extent in slopes is found at its corners.
+    float boxNear = std::max(depth - radius, sliceNear);
+    float boxFar = std::min(depth + radius, sliceFar);
+    int firstX = tileX(std::min((x - radius) / boxNear, (x - radius) / boxFar));
+    int lastX = tileX(std::max((x + radius) / boxNear, (x + radius) / boxFar));
+    int firstY = tileY(std::min((y - radius) / boxNear, (y - radius) / boxFar));
+    int lastY = tileY(std::max((y + radius) / boxNear, (y + radius) / boxFar));
+
+    // Test the sphere against each tile's bounding box within the slice.
+    for (int ty = firstY; ty <= lastY; ty++) {
+      float minY = std::min(slopesY[ty] * sliceNear, slopesY[ty] * sliceFar);
+      float maxY =
+          std::max(slopesY[ty + 1] * sliceNear, slopesY[ty + 1] * sliceFar);
+      float dy = std::max({minY - y, y - maxY, 0.0f});
+      float dz = std::max({sliceNear - depth, depth - sliceFar, 0.0f});
+      for (int tx = firstX; tx <= lastX; tx++) {
+        float minX = std::min(slopesX[tx] * sliceNear, slopesX[tx] * sliceFar);
+        float maxX =
+            std::max(slopesX[tx + 1] * sliceNear, slopesX[tx + 1] * sliceFar);
+        float dx = std::max({minX - x, x - maxX, 0.0f});
+        if (dx * dx + dy * dy + dz * dz <= radius * radius) {
+          uint16_t tile = (uint16_t)(ty * TilesX + tx);
+          scratch.pairs.emplace_back(tile, spheres.index[i]);
+          scratch.counts[tile]++;
+        }
+      }
+    }
+  }
+
+  // Sort the lights by cluster. Lights were visited in order, so each
+  // cluster's list stays in order too.
+  uint32_t starts[TilesX * TilesY];
+  uint32_t start = 0;
+  for (int tile = 0; tile < tilesPerSlice; tile++) {
+    starts[tile] = start;
+    start += scratch.counts[tile];
+  }
+  scratch.indices.resize(scratch.pairs.size());
+  for (const auto &pair : scratch.pairs) {
+    scratch.indices[starts[pair.first]++] = pair.second;
+  }
+}
+
+void dg::LightClusters::PackLight(const Light::ShaderData &light) {
+  lightData.push_back(glm::vec4(light.diffuse, (float)light.type));
+  lightData.push_back(glm::vec4(light.ambient, light.innerCutoff));
+  lightData.push_back(glm::vec4(light.specular, light.outerCutoff));
+  lightData.push_back(glm::vec4(light.position, light.constantCoeff));
+  lightData.push_back(glm::vec4(light.direction, light.linearCoeff));
+  lightData.push_back(
+      glm::vec4(light.quadraticCoeff, (float)light.hasShadow, 0, 0));
+  for (int column = 0; column < 4; column++) {
+    lightData.push_back(light.lightTransform[column]);
+  }
+  lightData.push_back(light.shadowRect);
+}
+
+void dg::LightClusters::Upload() {
+#if defined(_OPENGL)
+  const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R16UI};
+  if (buffers[0] == 0) {
+    glGenBuffers(3, buffers);
+    glGenTextures(3, textures);
+    for (int i = 0; i < 3; i++) {
+      glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+      glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+      glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+      glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+    }
+  }
+
+  // Reallocate every time, so that the driver can hand out new storage
+  // rather than wait for draws still reading the last frame's.
+  const void *data[3] = {lightData.data(), grid.data(), indices.data()};
+  const size_t sizes[3] = {lightData.size() * sizeof(glm::vec4),
+                           grid.size() * sizeof(glm::uvec2),
+                           indices.size() * sizeof(uint16_t)};
+  for (int i = 0; i < 3; i++) {
+    glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+    glBufferData(GL_TEXTURE_BUFFER, std::max(sizes[i], (size_t)16), nullptr,
+                 GL_STREAM_DRAW);
+    if (sizes[i] > 0) {
+      glBufferSubData(GL_TEXTURE_BUFFER, 0, sizes[i], data[i]);
+    }
+  }
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+#endif
+}
+
+glm::ivec3 dg::LightClusters::GetDimensions() const {
+  return dimensions;
+}
+
+float dg::LightClusters::GetDepthScale() const {
+  return depthScale;
+}
+
+float dg::LightClusters::GetDepthBias() const {
+  return depthBias;
+}
+
+int dg::LightClusters::GetLightCount() const {
+  return (int)(lightData.size() / LightDataTexels);
+}
+
+int dg::LightClusters::GetGlobalLightCount() const {
+  return globalLightCount;
+}
+
+size_t dg::LightClusters::GetIndexCount() const {
+  return indices.size();
+}
+
+#if defined(_OPENGL)
+GLuint dg::LightClusters::GetLightDataTexture() const {
+  return textures[0];
+}
+
+GLuint dg::LightClusters::GetLightGridTexture() const {
+  return textures[1];
+}
+
+GLuint dg::LightClusters::GetLightIndicesTexture() const {
+  return textures[2];
+}
+#endif
@@ -3,6 +3,10 @@
 //
 
 #include "dg/Lights.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
 #include "dg/Material.h"
 #include "dg/Texture.h"
 
@@ -15,9 +19,48 @@ const char *dg::Light::LIGHTS_ARRAY_NAME = "_Lights";
 const char *dg::Light::LIGHTS_ARRAY_NAME = "lights";
 #endif
 const int dg::Light::MAX_LIGHTS;
+constexpr float dg::Light::CutoffIntensity;
 
 #pragma region Light
 
+float dg::Light::Brightness(const ShaderData &light) {
+  return std::max(
+      {light.diffuse.r, light.diffuse.g, light.diffuse.b, light.ambient.r,
+       light.ambient.g, light.ambient.b, light.specular.r, light.specular.g,
+       light.specular.b});
+}
+
+float dg::Light::Attenuation(const ShaderData &light, float distance) {
+  if (light.type == LightType::DIRECTIONAL) {
+    return 1;
+  }
+  return 1.0f / (light.constantCoeff + light.linearCoeff * distance +
+                 light.quadraticCoeff * distance * distance);
+}
+
+float dg::Light::Range(const ShaderData &light) {
+  if (light.type == LightType::DIRECTIONAL) {
+    return std::numeric_limits<float>::infinity();
+  }
+
+  // Solve for the distance where the attenuation's denominator,
+  // c + l * d + q * d^2, divides brightness down to the cutoff.
+  float denominator = Brightness(light) / CutoffIntensity;
+  float c = light.constantCoeff;
+  float l = light.linearCoeff;
+  float q = light.quadraticCoeff;
+  if (denominator <= c) {
+    return 0;
+  }
+  if (q > 0) {
+    return (-l + std::sqrt(l * l - 4 * q * (c - denominator))) / (2 * q);
+  }
+  if (l > 0) {
+    return (denominator - c) / l;
+  }
+  return std::numeric_limits<float>::infinity();
+}
+
 dg::Light::Light(
   glm::vec3 color, float ambient, float diffuse, float specular)
   : Light(color * ambient, color * diffuse, color * specular) {}
@@ -41,9 +84,27 @@ void dg::Light::SetSpecular(const glm::vec3& specular) {
   data.specular = specular;
 }
 
-void dg::Light::SetShadowMap(std::shared_ptr<Texture> shadowMap) {
+void dg::Light::SetShadowMap(std::shared_ptr<Texture> shadowMap,
+                             const glm::vec4 &shadowRect) {
   this->shadowMap = shadowMap;
-  data.hasShadow = (shadowMap != nullptr) ? 1 : 0;
+  data.hasShadow = (int)((shadowMap != nullptr) ? ShadowType::ATLAS
+                                                : ShadowType::NONE);
+  data.shadowRect = shadowRect;
+}
+
+void dg::Light::SetShadowCascades(std::shared_ptr<Texture> cascadeMap) {
+  this->shadowMap = cascadeMap;
+  data.hasShadow = (int)((cascadeMap != nullptr) ? ShadowType::CASCADES
+                                                 : ShadowType::NONE);
+  data.shadowRect = glm::vec4(0, 0, 1, 1);
+}
+
+void dg::Light::SetShadowCube(std::shared_ptr<Texture> cubeMap, int index) {
+  assert(index >= 0 && index < MAX_SHADOW_CUBES);
+  this->shadowMap = cubeMap;
+  data.hasShadow =
+      (int)((cubeMap != nullptr) ? ShadowType::CUBE : ShadowType::NONE);
+  data.shadowRect = glm::vec4((float)index, 0, 0, 0);
 }
 
 void dg::Light::SetCastShadows(bool castShadows) {
@@ -70,6 +131,10 @@ std::shared_ptr<dg::Texture> dg::Light::GetShadowMap() const {
   return shadowMap;
 }
 
+const glm::vec4 &dg::Light::GetShadowRect() const {
+  return data.shadowRect;
+}
+
 bool dg::Light::GetCastShadows() const {
   return castShadows;
 }
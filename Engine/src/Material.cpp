@@ -3,8 +3,87 @@
 //
 
 #include "dg/Material.h"
+#include <algorithm>
 #include <glm/gtc/matrix_transform.hpp>
 #include "dg/Graphics.h"
+#include "dg/LightClusters.h"
+#include "dg/ShadowCascades.h"
+
+namespace {
+
+  // Fields of the light struct sent by Material::SendLight, in the order of
+  // LightFieldNames.
+  enum class LightField {
+    Type,
+    Diffuse,
+    Ambient,
+    Specular,
+    Position,
+    Direction,
+    InnerCutoff,
+    OuterCutoff,
+    ConstantCoeff,
+    LinearCoeff,
+    QuadraticCoeff,
+    HasShadow,
+    LightTransform,
+    ShadowRect,
+  };
+  const int LightFieldCount = (int)LightField::ShadowRect + 1;
+  const char *const LightFieldNames[LightFieldCount] = {
+      "type", "diffuse", "ambient", "specular", "position", "direction",
+      "innerCutoff", "outerCutoff", "constantCoeff", "linearCoeff",
+      "quadraticCoeff", "hasShadow", "lightTransform", "shadowRect",
+  };
+
+  // Names of the uniforms sent every draw. They're built once, since names
+  // longer than std::string's small buffer would otherwise allocate each
+  // time they're passed to the shader.
+  struct UniformNames {
+
+    UniformNames();
+
+    std::string bufferDimensions = "_BufferDimensions";
+    std::string lights[dg::Light::MAX_LIGHTS][LightFieldCount];
+
+    std::string clusterTilesX = "_LightClusters.tilesX";
+    std::string clusterTilesY = "_LightClusters.tilesY";
+    std::string clusterSlices = "_LightClusters.slices";
+    std::string clusterDepthScale = "_LightClusters.depthScale";
+    std::string clusterDepthBias = "_LightClusters.depthBias";
+    std::string clusterGlobalLights = "_LightClusters.globalLights";
+
+    std::string cascadeMap = "_ShadowCascadeMap";
+    std::string cascadeCount = "_ShadowCascades.count";
+    std::string cascadeSplits = "_ShadowCascades.splits";
+    std::string cascadeTransforms[dg::ShadowCascades::MaxCascades];
+
+    std::string shadowCubes[dg::Light::MAX_SHADOW_CUBES];
+
+  }; // struct UniformNames
+
+  UniformNames::UniformNames() {
+    for (int i = 0; i < dg::Light::MAX_LIGHTS; i++) {
+      for (int field = 0; field < LightFieldCount; field++) {
+        lights[i][field] = std::string(dg::Light::LIGHTS_ARRAY_NAME) + "[" +
+                           std::to_string(i) + "]." + LightFieldNames[field];
+      }
+    }
+    for (int i = 0; i < dg::ShadowCascades::MaxCascades; i++) {
+      cascadeTransforms[i] =
+          "_ShadowCascades.transforms[" + std::to_string(i) + "]";
+    }
+    for (int i = 0; i < dg::Light::MAX_SHADOW_CUBES; i++) {
+      shadowCubes[i] = "_ShadowCubes[" + std::to_string(i) + "]";
+    }
+  }
+
+  const UniformNames &Names() {
+    static const UniformNames names;
+    return names;
+  }
+
+} // namespace
 
 dg::Material::Material(Material& other) {
   this->shader = other.shader;
@@ -109,7 +188,7 @@ void dg::Material::ClearProperty(const std::string& name) {
 }
 
 void dg::Material::SendBufferDimensions(glm::vec2 dimensions) {
-  shader->SetVec2("_BufferDimensions", dimensions);
+  shader->SetVec2(Names().bufferDimensions, dimensions);
 }
 
 void dg::Material::SendCameraPosition(glm::vec3 position) {
@@ -142,19 +221,23 @@ void dg::Material::SendMatrixNormal(glm::mat4x4 normal) {
 
 #if defined(_OPENGL)
 void dg::Material::SendLight(int index, const Light::ShaderData& data) {
-  shader->SetVec3(LightProperty(index, "diffuse"), data.diffuse);
-  shader->SetInt(LightProperty(index, "type"), (int)data.type);
-  shader->SetVec3(LightProperty(index, "ambient"), data.ambient);
-  shader->SetFloat(LightProperty(index, "innerCutoff"), data.innerCutoff);
-  shader->SetVec3(LightProperty(index, "specular"), data.specular);
-  shader->SetFloat(LightProperty(index, "outerCutoff"), data.outerCutoff);
-  shader->SetVec3(LightProperty(index, "position"), data.position);
-  shader->SetFloat(LightProperty(index, "constantCoeff"), data.constantCoeff);
-  shader->SetVec3(LightProperty(index, "direction"), data.direction);
-  shader->SetFloat(LightProperty(index, "linearCoeff"), data.linearCoeff);
-  shader->SetFloat(LightProperty(index, "quadraticCoeff"), data.quadraticCoeff);
-  shader->SetInt(LightProperty(index, "hasShadow"), data.hasShadow);
-  shader->SetMat4(LightProperty(index, "lightTransform"), data.lightTransform);
+  const std::string (&names)[LightFieldCount] = Names().lights[index];
+  shader->SetVec3(names[(int)LightField::Diffuse], data.diffuse);
+  shader->SetInt(names[(int)LightField::Type], (int)data.type);
+  shader->SetVec3(names[(int)LightField::Ambient], data.ambient);
+  shader->SetFloat(names[(int)LightField::InnerCutoff], data.innerCutoff);
+  shader->SetVec3(names[(int)LightField::Specular], data.specular);
+  shader->SetFloat(names[(int)LightField::OuterCutoff], data.outerCutoff);
+  shader->SetVec3(names[(int)LightField::Position], data.position);
+  shader->SetFloat(names[(int)LightField::ConstantCoeff], data.constantCoeff);
+  shader->SetVec3(names[(int)LightField::Direction], data.direction);
+  shader->SetFloat(names[(int)LightField::LinearCoeff], data.linearCoeff);
+  shader->SetFloat(
+      names[(int)LightField::QuadraticCoeff], data.quadraticCoeff);
+  shader->SetInt(names[(int)LightField::HasShadow], data.hasShadow);
+  shader->SetMat4(
+      names[(int)LightField::LightTransform], data.lightTransform);
+  shader->SetVec4(names[(int)LightField::ShadowRect], data.shadowRect);
 }
 
 void dg::Material::ClearLights() {
@@ -164,7 +247,8 @@ void dg::Material::ClearLights() {
 }
 
 void dg::Material::ClearLight(int index) {
-  shader->SetInt(LightProperty(index, "type"), (int)Light::LightType::NONE);
+  shader->SetInt(Names().lights[index][(int)LightField::Type],
+                 (int)Light::LightType::NONE);
 }
 #endif
 
@@ -184,14 +268,12 @@ void dg::Material::SendLights(
 #endif
 }
 
-const std::string dg::Material::LightProperty(
-    int index, const std::string& property) {
-  char buffer[128];
-  assert(index >= 0 && index < Light::MAX_LIGHTS);
-  assert(snprintf(
-        buffer, sizeof(buffer), "%s[%d].%s",
-        Light::LIGHTS_ARRAY_NAME, index, property.c_str()) >= 0);
-  return std::string(buffer);
+bool dg::Material::UsesLightArray() const {
+#if defined(_OPENGL)
+  return shader->HasUniform(Names().lights[0][(int)LightField::Type]);
+#elif defined(_DIRECTX)
+  return shader->HasUniform(Light::LIGHTS_ARRAY_NAME);
+#endif
 }
 
 void dg::Material::SendShadowMap(std::shared_ptr<Texture> shadowMap) {
@@ -202,6 +284,90 @@ void dg::Material::SendShadowMap(std::shared_ptr<Texture> shadowMap) {
 #endif
 }
 
+void dg::Material::SendLightClusters(const LightClusters *clusters) {
+#if defined(_OPENGL)
+  // Samplers of different types can't share a texture unit, so the buffer
+  // samplers are always pointed at their own units, even with nothing bound.
+  const struct {
+    const char *name;
+    TexUnitHints unit;
+    GLuint texture;
+  } samplers[] = {
+      {"_LightData", TexUnitHints::LIGHT_DATA,
+       clusters != nullptr ? clusters->GetLightDataTexture() : 0},
+      {"_LightGrid", TexUnitHints::LIGHT_GRID,
+       clusters != nullptr ? clusters->GetLightGridTexture() : 0},
+      {"_LightIndices", TexUnitHints::LIGHT_INDICES,
+       clusters != nullptr ? clusters->GetLightIndicesTexture() : 0},
+  };
+  for (const auto &sampler : samplers) {
+    if (sampler.texture != 0) {
+      glActiveTexture(GL_TEXTURE0 + (int)sampler.unit);
+      glBindTexture(GL_TEXTURE_BUFFER, sampler.texture);
+    }
+    shader->SetInt(sampler.name, (int)sampler.unit);
+  }
+
+  const UniformNames &names = Names();
+  if (clusters == nullptr) {
+    shader->SetInt(names.clusterTilesX, 0);
+    shader->SetInt(names.clusterGlobalLights, 0);
+    return;
+  }
+  glm::ivec3 dimensions = clusters->GetDimensions();
+  shader->SetInt(names.clusterTilesX, dimensions.x);
+  shader->SetInt(names.clusterTilesY, dimensions.y);
+  shader->SetInt(names.clusterSlices, dimensions.z);
+  shader->SetFloat(names.clusterDepthScale, clusters->GetDepthScale());
+  shader->SetFloat(names.clusterDepthBias, clusters->GetDepthBias());
+  shader->SetInt(names.clusterGlobalLights, clusters->GetGlobalLightCount());
+#elif defined(_DIRECTX)
+  // TODO
+#endif
+}
+
+void dg::Material::SendShadowCascades(const ShadowCascades *cascades) {
+#if defined(_OPENGL)
+  // Like the light clusters' buffer samplers, the array sampler is always
+  // pointed at its own unit.
+  const UniformNames &names = Names();
+  std::shared_ptr<Texture> shadowMap =
+      (cascades != nullptr) ? cascades->GetShadowMap() : nullptr;
+  if (shadowMap == nullptr) {
+    shader->SetInt(names.cascadeMap, (int)TexUnitHints::SHADOW_CASCADES);
+    shader->SetInt(names.cascadeCount, 0);
+    return;
+  }
+  shader->SetTexture((int)TexUnitHints::SHADOW_CASCADES, names.cascadeMap,
+                     shadowMap.get());
+  shader->SetInt(names.cascadeCount, cascades->GetCount());
+  shader->SetVec4(names.cascadeSplits, cascades->GetSplits());
+  for (int i = 0; i < cascades->GetCount(); i++) {
+    shader->SetMat4(names.cascadeTransforms[i], cascades->GetTransform(i));
+  }
+#elif defined(_DIRECTX)
+  // TODO
+#endif
+}
+
+void dg::Material::SendShadowCubes(
+    const std::shared_ptr<Texture> (*cubes)[Light::MAX_SHADOW_CUBES]) {
+#if defined(_OPENGL)
+  // Cube samplers also get units of their own, bound or not.
+  for (int i = 0; i < Light::MAX_SHADOW_CUBES; i++) {
+    int unit = (int)TexUnitHints::SHADOW_CUBES + i;
+    const std::string &name = Names().shadowCubes[i];
+    if (cubes != nullptr && (*cubes)[i] != nullptr) {
+      shader->SetTexture(unit, name, (*cubes)[i].get());
+    } else {
+      shader->SetInt(name, unit);
+    }
+  }
+#elif defined(_DIRECTX)
+  // TODO
+#endif
+}
+
 void dg::Material::Use() const {
   assert(shader != nullptr);
 
@@ -217,7 +383,8 @@ void dg::Material::Use() const {
 }
 
 void dg::Material::SendShaderProperties() const {
-  unsigned int textureUnit = highestTexUnitHint + 1;
+  unsigned int textureUnit =
+      std::max(highestTexUnitHint + 1, (unsigned int)TexUnitHints::END);
   for (auto it = properties.begin(); it != properties.end(); it++) {
     switch (it->second.type) {
       case PropertyType::BOOL:
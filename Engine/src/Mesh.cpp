@@ -183,7 +183,14 @@ void dg::Mesh::AddTriangle(const Triangle &triangle) {
     unsigned int index = -1;
     if (pair == vertexMap.end()) {
       if (!!(attributes & Flag::POSITION)) {
-        vertexPositions.push_back(v[i]->data.position);
+        const glm::vec3 &position = v[i]->data.position;
+        if (vertexPositions.empty()) {
+          boundsMin = boundsMax = position;
+        } else {
+          boundsMin = glm::min(boundsMin, position);
+          boundsMax = glm::max(boundsMax, position);
+        }
+        vertexPositions.push_back(position);
       }
       if (!!(attributes & Flag::NORMAL)) {
         vertexNormals.push_back(v[i]->data.normal);
@@ -219,6 +226,14 @@ const dg::Vertex dg::Mesh::GetVertex(int i) const {
   return vertex;
 }
 
+glm::vec3 dg::Mesh::GetBoundsCenter() const {
+  return (boundsMin + boundsMax) * 0.5f;
+}
+
+float dg::Mesh::GetBoundsRadius() const {
+  return glm::length(boundsMax - boundsMin) * 0.5f;
+}
+
 void dg::Mesh::Draw() const {
   Graphics::Instance->ApplyCurrentRasterizerState();
 }
@@ -18,6 +18,7 @@ dg::Model::Model(Model& other) : SceneObject(other) {
   this->mesh = other.mesh;
   this->material = other.material;
   this->layer = other.layer;
+  this->isStatic = other.isStatic;
 }
 
 void dg::Model::Draw(glm::mat4x4 view, glm::mat4x4 projection,
@@ -33,8 +34,12 @@ void dg::Model::Draw(const DrawContext &context, Material *material) const {
     material = this->material.get();
   }
 
-  glm::mat4x4 xfMat = CachedSceneSpace().ToMat4();
+  BeginMaterial(context, material);
+  DrawWithMaterial(context, material);
+  EndMaterial(material);
+}
 
+void dg::Model::BeginMaterial(const DrawContext &context, Material *material) {
   if (material->rasterizerOverride.HasDeclaredAttributes()) {
     Graphics::Instance->PushRasterizerState(material->rasterizerOverride);
   }
@@ -51,23 +56,39 @@ void dg::Model::Draw(const DrawContext &context, Material *material) const {
     material->SendLights(*context.lights);
   }
 
+  material->SendLightClusters(context.lightClusters);
+
   if (context.shadowMap != nullptr) {
     material->SendShadowMap(context.shadowMap);
   }
+  material->SendShadowCascades(context.shadowCascades);
+  material->SendShadowCubes(context.shadowCubes);
 
   material->SendBufferDimensions(Graphics::Instance->GetViewportDimensions());
-  material->SendMatrixNormal(glm::transpose(glm::inverse(xfMat)));
-  material->SendMatrixM(xfMat);
   material->SendMatrixV(context.view);
   material->SendMatrixP(context.projection);
-  material->SendMatrixMVP(context.projection * context.view * xfMat);
+}
+
+void dg::Model::DrawWithMaterial(const DrawContext &context,
+                                 Material *material) const {
+  const glm::mat4x4 &xfMat = CachedSceneSpaceMatrix();
+
+  material->SendMatrixNormal(CachedNormalMatrix());
+  material->SendMatrixM(xfMat);
+  if (context.matrixMVP != nullptr) {
+    material->SendMatrixMVP(*context.matrixMVP);
+  } else {
+    material->SendMatrixMVP(context.projection * context.view * xfMat);
+  }
 
 #if defined(_DIRECTX)
   material->Use();
 #endif
 
   mesh->Draw();
+}
 
+void dg::Model::EndMaterial(Material *material) {
   if (material->rasterizerOverride.HasDeclaredAttributes()) {
     Graphics::Instance->PopRasterizerState();
   }
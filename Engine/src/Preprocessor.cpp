@@ -3,113 +3,321 @@
 //
 
 #include "dg/Preprocessor.h"
-#include <fstream>
-#include <sstream>
 #include <string>
 #include "dg/FileUtils.h"
 
+std::unordered_map<std::string,
+                   std::shared_ptr<const dg::Preprocessor::File>>
+    dg::Preprocessor::fileCache;
+std::mutex dg::Preprocessor::fileCacheMutex;
+
 std::shared_ptr<dg::Preprocessor> dg::Preprocessor::ForFile(
     const std::string &filename) {
   auto pp = std::shared_ptr<Preprocessor>(new Preprocessor());
-  pp->filename = filename;
+  pp->filename = FileUtils::FlattenPath(filename);
+  return pp;
+}
+
+std::shared_ptr<dg::Preprocessor> dg::Preprocessor::ForFile(
+    const std::string &filename, const std::vector<std::string> &defines) {
+  auto pp = ForFile(filename);
+  pp->defines = defines;
   return pp;
 }
 
 const std::string &dg::Preprocessor::GetProcessedContent() {
-  return GetProcessedFile(GetFile(filename)).processedContent;
+  if (!processed) {
+    auto file = GetFile(filename);
+
+    definedNames = std::set<std::string>(defines.begin(), defines.end());
+    fileIDs.clear();
+    fileIDs[file->filename] = 0;
+    processedContent.clear();
+    processedContent.reserve(file->content.size() * 2);
+    AppendFile(*file, processedContent);
+
+    definedNames.clear();
+    conditionals.clear();
+    fileIDs.clear();
+    processed = true;
+  }
+
+  return processedContent;
 }
 
-dg::Preprocessor::File &dg::Preprocessor::GetFile(const std::string &filename) {
-  if (files.find(filename) == files.end()) {
-    files[filename] = {};
-    files[filename].filename = filename;
-    files[filename].id = nextFileID;
-    files[filename].lines = FileUtils::LoadFileLines(filename);
-    nextFileID++;
+std::shared_ptr<const dg::Preprocessor::File> dg::Preprocessor::GetFile(
+    const std::string &filename) {
+  std::error_code error;
+  auto modifiedTime = std::filesystem::last_write_time(filename, error);
+
+  {
+    std::lock_guard<std::mutex> lock(fileCacheMutex);
+    auto cached = fileCache.find(filename);
+    if (cached != fileCache.end() && !error &&
+        cached->second->modifiedTime == modifiedTime) {
+      return cached->second;
+    }
   }
 
-  return files.at(filename);
+  // Load outside of the lock so other threads can keep using the cache. If
+  // two threads load the same file, the last one wins, which is harmless.
+  auto file = std::make_shared<File>();
+  file->filename = filename;
+  file->modifiedTime = modifiedTime;
+  file->content = FileUtils::LoadFile(filename);
+  TokenizeFile(*file);
+
+  std::lock_guard<std::mutex> lock(fileCacheMutex);
+  fileCache[filename] = file;
+  return file;
 }
 
-dg::Preprocessor::File &dg::Preprocessor::GetProcessedFile(File &file) {
-  currentFilenames.insert(file.filename);
+int dg::Preprocessor::FileID(const std::string &filename) {
+  auto inserted = fileIDs.emplace(filename, (int)fileIDs.size());
+  return inserted.first->second;
+}
 
-  if (file.processed) {
-    return file;
+std::string dg::Preprocessor::StripComments(const std::string &content,
+                                            size_t start, size_t end,
+                                            bool &inBlockComment) {
+  std::string code;
+  size_t i = start;
+  while (i < end) {
+    if (inBlockComment) {
+      size_t commentEnd = content.find("*/", i);
+      if (commentEnd == std::string::npos || commentEnd + 2 > end) {
+        return code;
+      }
+      inBlockComment = false;
+      i = commentEnd + 2;
+      code += ' ';
+    } else if (content.compare(i, 2, "//") == 0) {
+      return code;
+    } else if (content.compare(i, 2, "/*") == 0) {
+      inBlockComment = true;
+      i += 2;
+    } else {
+      code += content[i];
+      i++;
+    }
   }
+  return code;
+}
 
-  std::stringstream content;
+void dg::Preprocessor::TokenizeFile(File &file) {
+  const std::string &content = file.content;
+  const std::string whitespace = " \t\r";
 
+  file.segments.clear();
+
+  bool inBlockComment = false;
   int lineNumber = 0;
-  bool inComment = false;
-  for (std::string &line : file.lines) {
+  size_t lineStart = 0;
+  while (lineStart < content.length()) {
     lineNumber++;
+    size_t lineEnd = content.find('\n', lineStart);
+    size_t nextLineStart =
+        (lineEnd == std::string::npos) ? content.length() : lineEnd + 1;
+    if (lineEnd == std::string::npos) {
+      lineEnd = content.length();
+    }
 
-    // FIXME: This is really sloppy naive parsing for comments, block comments,
-    //        and includes. I'm implementing this to solve a specific problem,
-    //        but it should ideally be tokenized and parsed accurately.
+    // Directives must be the first token on their line. Comments are
+    // stripped first so that directives inside block comments and comments
+    // trailing directives are ignored.
+    std::string code =
+        StripComments(content, lineStart, lineEnd, inBlockComment);
+    size_t hash = code.find_first_not_of(whitespace);
 
-    if (inComment) {
-      if (line.find("*/") != std::string::npos) {
-        inComment = false;
+    Segment segment;
+    segment.start = lineStart;
+    segment.length = nextLineStart - lineStart;
+    segment.line = lineNumber;
+
+    if (hash != std::string::npos && code[hash] == '#') {
+      size_t nameStart = code.find_first_not_of(whitespace, hash + 1);
+      size_t nameEnd = code.find_first_of(whitespace + "(\"<", nameStart);
+      std::string name = (nameStart == std::string::npos)
+                             ? ""
+                             : code.substr(nameStart, nameEnd - nameStart);
+      std::string argument;
+      if (nameEnd != std::string::npos) {
+        size_t argStart = code.find_first_not_of(whitespace, nameEnd);
+        size_t argEnd = code.find_last_not_of(whitespace);
+        if (argStart != std::string::npos) {
+          argument = code.substr(argStart, argEnd - argStart + 1);
+        }
       }
 
-      // We're in a block comment, so ignore this line.
-      continue;
+      // Name of the macro at the start of the argument, for #define and
+      // friends.
+      std::string macro =
+          argument.substr(0, argument.find_first_of(whitespace + "("));
+
+      if (name == "include") {
+        if (argument.empty()) {
+          throw EmptyError(file.filename, lineNumber);
+        }
+        size_t quoteEnd = argument.find('"', 1);
+        if (argument[0] != '"' || quoteEnd == std::string::npos) {
+          throw UnterminatedQuoteError(file.filename, lineNumber);
+        }
+        if (quoteEnd == 1) {
+          throw EmptyError(file.filename, lineNumber);
+        }
+        segment.directive = DirectiveType::INCLUDE;
+        segment.argument = FileUtils::FlattenPath(
+            FileUtils::DirectoryPathOfFilePath(file.filename) + "/" +
+            argument.substr(1, quoteEnd - 1));
+      } else if (name == "version") {
+        segment.directive = DirectiveType::VERSION;
+      } else if (name == "define") {
+        segment.directive = DirectiveType::DEFINE;
+        segment.argument = macro;
+      } else if (name == "undef") {
+        segment.directive = DirectiveType::UNDEF;
+        segment.argument = macro;
+      } else if (name == "if") {
+        segment.directive = DirectiveType::IF;
+      } else if (name == "ifdef") {
+        segment.directive = DirectiveType::IFDEF;
+        segment.argument = macro;
+      } else if (name == "ifndef") {
+        segment.directive = DirectiveType::IFNDEF;
+        segment.argument = macro;
+      } else if (name == "elif") {
+        segment.directive = DirectiveType::ELIF;
+      } else if (name == "else") {
+        segment.directive = DirectiveType::ELSE;
+      } else if (name == "endif") {
+        segment.directive = DirectiveType::ENDIF;
+      }
     }
 
-    if (line.find("/*") != std::string::npos) {
-      inComment = true;
-      continue;
+    // Merge consecutive plain lines into a single segment.
+    if (segment.directive == DirectiveType::NONE && !file.segments.empty() &&
+        file.segments.back().directive == DirectiveType::NONE) {
+      file.segments.back().length += segment.length;
+    } else {
+      file.segments.push_back(segment);
     }
 
-    const std::string lineCommentPrefix = "//";
-    const std::string includePatternPrefix = "#include \"";
-    const std::string includePatternSuffix = "\"";
+    lineStart = nextLineStart;
+  }
+}
 
-    size_t includeQuoteStart = line.find(includePatternPrefix);
-    if (includeQuoteStart == std::string::npos) {
-      content << line << std::endl;
-      continue;
-    }
-    includeQuoteStart += includePatternPrefix.length();
-
-    // See if a line comment has started before the #include.
-    size_t lineCommentStart = line.find(lineCommentPrefix);
-    if (lineCommentStart != std::string::npos &&
-        lineCommentStart <= includeQuoteStart) {
-      content << line << std::endl;
-      continue;
-    }
+bool dg::Preprocessor::IsActive() const {
+  return conditionals.empty() ||
+         (conditionals.back().parentActive && conditionals.back().active);
+}
 
-    size_t includeQuoteEnd =
-        line.find(includePatternSuffix, includeQuoteStart);
-    if (includeQuoteStart == std::string::npos) {
-      throw UnterminatedQuoteError(file, lineNumber);
-    }
+void dg::Preprocessor::AppendFile(const File &file, std::string &output) {
+  currentFilenames.insert(file.filename);
 
-    if (includeQuoteEnd <= includeQuoteStart) {
-      throw EmptyError(file, lineNumber);
-    };
+  for (const Segment &segment : file.segments) {
+    switch (segment.directive) {
+      case DirectiveType::INCLUDE: {
+        if (!IsActive()) {
+          // Keep line numbers intact.
+          output += '\n';
+          break;
+        }
 
-    std::string includeFilename =
-        line.substr(includeQuoteStart, includeQuoteEnd - includeQuoteStart);
+        if (currentFilenames.count(segment.argument) > 0) {
+          throw CycleError(file.filename, segment.line);
+        }
 
-    std::string includeFilePath = FileUtils::FlattenPath(
-        FileUtils::DirectoryPathOfFilePath(file.filename) + "/" +
-        includeFilename);
+        auto include = GetFile(segment.argument);
+        output += "#line 1 " + std::to_string(FileID(include->filename)) +
+                  "\n";
+        AppendFile(*include, output);
+        if (!output.empty() && output.back() != '\n') {
+          output += '\n';
+        }
+        output += "#line " + std::to_string(segment.line + 1) + " " +
+                  std::to_string(FileID(file.filename)) + "\n";
+        break;
+      }
 
-    if (currentFilenames.count(includeFilePath) > 0) {
-      throw CycleError(file, lineNumber);
-    }
+      case DirectiveType::VERSION:
+        output.append(file.content, segment.start, segment.length);
+        if (file.filename == filename && !defines.empty()) {
+          if (output.back() != '\n') {
+            output += '\n';
+          }
+          // Defines must come after #version, which must be the first
+          // directive in a GLSL file.
+          for (const std::string &define : defines) {
+            output += "#define " + define + "\n";
+          }
+          output += "#line " + std::to_string(segment.line + 1) + " " +
+                    std::to_string(FileID(file.filename)) + "\n";
+        }
+        break;
+
+      case DirectiveType::DEFINE:
+        output.append(file.content, segment.start, segment.length);
+        if (IsActive()) {
+          definedNames.insert(segment.argument);
+        }
+        break;
+
+      case DirectiveType::UNDEF:
+        output.append(file.content, segment.start, segment.length);
+        if (IsActive()) {
+          definedNames.erase(segment.argument);
+        }
+        break;
+
+      case DirectiveType::IF:
+      case DirectiveType::IFDEF:
+      case DirectiveType::IFNDEF: {
+        output.append(file.content, segment.start, segment.length);
+        Conditional conditional;
+        conditional.parentActive = IsActive();
+        conditional.known = (segment.directive != DirectiveType::IF);
+        if (conditional.known) {
+          bool defined = definedNames.count(segment.argument) > 0;
+          conditional.active =
+              (segment.directive == DirectiveType::IFDEF) ? defined : !defined;
+        } else {
+          conditional.active = true;
+        }
+        conditional.taken = conditional.active;
+        conditionals.push_back(conditional);
+        break;
+      }
+
+      case DirectiveType::ELIF:
+      case DirectiveType::ELSE:
+        output.append(file.content, segment.start, segment.length);
+        if (!conditionals.empty()) {
+          Conditional &conditional = conditionals.back();
+          if (conditional.known && conditional.taken) {
+            conditional.active = false;
+          } else if (segment.directive == DirectiveType::ELIF) {
+            // The #elif condition isn't evaluated.
+            conditional.known = false;
+            conditional.active = true;
+          } else {
+            conditional.active = true;
+          }
+          conditional.taken = conditional.taken || conditional.active;
+        }
+        break;
+
+      case DirectiveType::ENDIF:
+        output.append(file.content, segment.start, segment.length);
+        if (!conditionals.empty()) {
+          conditionals.pop_back();
+        }
+        break;
 
-    auto &includeFile = GetProcessedFile(GetFile(includeFilePath));
-    content << "#line 1 " << includeFile.id << std::endl;
-    content << includeFile.processedContent;
-    content << "#line " << (lineNumber + 1) << " " << file.id << std::endl;
+      case DirectiveType::NONE:
+        output.append(file.content, segment.start, segment.length);
+        break;
+    }
   }
 
-  file.processedContent = content.str();
   currentFilenames.erase(file.filename);
-  return file;
 }
@@ -6,6 +6,13 @@
 #include <sstream>
 #include <string>
 
+const dg::RasterizerState::AttrFlag dg::RasterizerState::AllAttributes =
+    dg::RasterizerState::AttrFlag::None
+#define STATE_ATTRIBUTE(index, attr_type, public_name, member_name) \
+    | dg::RasterizerState::AttrFlag::public_name
+#include "dg/RasterizerStateAttributes.def"
+    ;
+
 dg::RasterizerState dg::RasterizerState::Default() {
   RasterizerState state;
   state.SetCullMode(CullMode::BACK);
@@ -60,6 +67,8 @@ dg::RasterizerState dg::RasterizerState::Wireframe() {
 dg::RasterizerState::RasterizerState(const RasterizerState &other) {
   declaredAttributes = other.declaredAttributes;
   importantAttributes = other.importantAttributes;
+  hash = other.hash;
+  hashValid = other.hashValid;
 
 #define STATE_ATTRIBUTE(index, attr_type, public_name, member_name) \
   member_name = other.member_name;
@@ -70,6 +79,42 @@ bool dg::RasterizerState::HasDeclaredAttributes() const {
   return static_cast<std::underlying_type_t<AttrFlag>>(declaredAttributes) > 0;
 }
 
+bool dg::RasterizerState::DeclaresAllAttributes() const {
+  return (declaredAttributes & AllAttributes) == AllAttributes;
+}
+
+dg::RasterizerState::hash_type dg::RasterizerState::GetHash() const {
+  if (hashValid) {
+    return hash;
+  }
+
+  hash = 0;
+  std::hash_combine(hash, declaredAttributes);
+  std::hash_combine(hash, importantAttributes);
+#define STATE_ATTRIBUTE(index, attr_type, public_name, member_name) \
+  if (Declares##public_name()) { \
+    std::hash_combine(hash, member_name); \
+  }
+#include "dg/RasterizerStateAttributes.def"
+  hashValid = true;
+  return hash;
+}
+
+bool dg::operator==(const RasterizerState &lhs, const RasterizerState &rhs) {
+  if (lhs.declaredAttributes != rhs.declaredAttributes ||
+      lhs.importantAttributes != rhs.importantAttributes) {
+    return false;
+  }
+
+#define STATE_ATTRIBUTE(index, attr_type, public_name, member_name) \
+  if (lhs.Declares##public_name() && lhs.member_name != rhs.member_name) { \
+    return false; \
+  }
+#include "dg/RasterizerStateAttributes.def"
+
+  return true;
+}
+
 dg::RasterizerState dg::RasterizerState::Flatten(const RasterizerState &parent,
                                                  const RasterizerState &child) {
   // Early out if child doesn't declare anything.
@@ -107,9 +152,11 @@ void dg::RasterizerState::Set##public_name(attr_type member_name, bool important
   this->member_name = member_name; \
   DeclareAttribute(AttrFlag::public_name); \
   SetImportant(AttrFlag::public_name, important); \
+  hashValid = false; \
 } \
 void dg::RasterizerState::Clear##public_name() { \
   UndeclareAttribute(AttrFlag::public_name); \
+  hashValid = false; \
 } \
 attr_type dg::RasterizerState::Get##public_name() const { \
   return member_name; \
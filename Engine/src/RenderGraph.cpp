@@ -0,0 +1,305 @@
+//
+//  RenderGraph.cpp
+//
+
+#include "dg/RenderGraph.h"
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include "dg/ResourcePool.h"
+
+#pragma region Declaration
+
+void dg::RenderGraph::PassBuilder::Read(Resource resource) {
+  assert(resource >= 0 && resource < graph.resourceCount);
+  graph.passes[pass].reads.push_back(resource);
+}
+
+void dg::RenderGraph::PassBuilder::Write(Resource resource) {
+  assert(resource >= 0 && resource < graph.resourceCount);
+  graph.passes[pass].writes.push_back(resource);
+  graph.resources[resource].writers.push_back(pass);
+}
+
+void dg::RenderGraph::PassBuilder::SideEffect() {
+  graph.passes[pass].sideEffect = true;
+}
+
+dg::RenderGraph::~RenderGraph() {
+  ReleaseFrameBuffers();
+}
+
+void dg::RenderGraph::Reset() {
+  // Clear the last frame's entries without freeing their lists, so that the
+  // next frame can fill them again.
+  for (int i = 0; i < resourceCount; i++) {
+    ResourceEntry &resource = resources[i];
+    resource.framebuffer = nullptr;
+    resource.imported = false;
+    resource.writers.clear();
+    resource.firstUse = -1;
+    resource.lastUse = -1;
+  }
+  for (int i = 0; i < passCount; i++) {
+    Pass &pass = passes[i];
+    pass.execute = nullptr;
+    pass.reads.clear();
+    pass.writes.clear();
+    pass.sideEffect = false;
+    pass.culled = true;
+  }
+  resourceCount = 0;
+  passCount = 0;
+  ReleaseFrameBuffers();
+}
+
+void dg::RenderGraph::ReleaseFrameBuffers() {
+  for (const auto &physical : physicalFrameBuffers) {
+    ResourcePool::ReleaseFrameBuffer(physical.framebuffer);
+  }
+  physicalFrameBuffers.clear();
+}
+
+dg::RenderGraph::ResourceEntry &dg::RenderGraph::AddResource(
+    const char *name) {
+  if (resourceCount == (int)resources.size()) {
+    resources.emplace_back();
+  }
+  ResourceEntry &resource = resources[resourceCount++];
+  resource.name = name;
+  return resource;
+}
+
+dg::RenderGraph::Resource dg::RenderGraph::CreateFrameBuffer(
+    const char *name, const FrameBuffer::Options &options) {
+  ResourceEntry &resource = AddResource(name);
+  resource.options = options;
+  return (Resource)resourceCount - 1;
+}
+
+dg::RenderGraph::Resource dg::RenderGraph::ImportFrameBuffer(
+    const char *name, std::shared_ptr<FrameBuffer> framebuffer) {
+  assert(framebuffer != nullptr);
+  ResourceEntry &resource = AddResource(name);
+  resource.options = framebuffer->GetOptions();
+  resource.framebuffer = framebuffer;
+  resource.imported = true;
+  return (Resource)resourceCount - 1;
+}
+
+void dg::RenderGraph::AddPass(
+    const char *name, const std::function<void(PassBuilder &)> &setup,
+    std::function<void(RenderGraph &)> execute) {
+  if (passCount == (int)passes.size()) {
+    passes.emplace_back();
+  }
+  Pass &pass = passes[passCount++];
+  pass.name = name;
+  pass.execute = std::move(execute);
+
+  PassBuilder builder(*this, passCount - 1);
+  setup(builder);
+}
+
+std::shared_ptr<dg::FrameBuffer> dg::RenderGraph::GetFrameBuffer(
+    Resource resource) const {
+  assert(resource >= 0 && resource < resourceCount);
+  return resources[resource].framebuffer;
+}
+
+#pragma endregion
+#pragma region Compilation
+
+void dg::RenderGraph::Cull() {
+  // Walk back from the passes with side effects to every pass writing
+  // something they read.
+  remaining.clear();
+  for (int i = 0; i < passCount; i++) {
+    passes[i].culled = !passes[i].sideEffect;
+    if (passes[i].sideEffect) {
+      remaining.push_back(i);
+    }
+  }
+  while (!remaining.empty()) {
+    int pass = remaining.back();
+    remaining.pop_back();
+    for (Resource resource : passes[pass].reads) {
+      for (int writer : resources[resource].writers) {
+        if (passes[writer].culled) {
+          passes[writer].culled = false;
+          remaining.push_back(writer);
+        }
+      }
+    }
+  }
+}
+
+void dg::RenderGraph::Order() {
+  if ((int)dependents.size() < passCount) {
+    dependents.resize(passCount);
+  }
+  for (int pass = 0; pass < passCount; pass++) {
+    dependents[pass].clear();
+  }
+  dependencyCounts.assign(passCount, 0);
+  auto addDependency = [&](int before, int after) {
+    if (before != after && !passes[before].culled) {
+      dependents[before].push_back(after);
+      dependencyCounts[after]++;
+    }
+  };
+
+  for (int pass = 0; pass < passCount; pass++) {
+    if (passes[pass].culled) {
+      continue;
+    }
+    // Reads come after every write of the resource.
+    for (Resource resource : passes[pass].reads) {
+      for (int writer : resources[resource].writers) {
+        addDependency(writer, pass);
+      }
+    }
+    // Writes come after earlier writes and reads of the resource, in the
+    // order they were declared.
+    for (Resource resource : passes[pass].writes) {
+      for (int other = 0; other < pass; other++) {
+        const Pass &earlier = passes[other];
+        if (std::find(earlier.writes.begin(), earlier.writes.end(),
+                      resource) != earlier.writes.end() ||
+            std::find(earlier.reads.begin(), earlier.reads.end(),
+                      resource) != earlier.reads.end()) {
+          addDependency(other, pass);
+        }
+      }
+    }
+  }
+
+  // Among passes that are ready, always run the one declared first, so that
+  // passes without dependencies between them keep their declared order.
+  // ready is a min-heap of pass indices.
+  std::greater<int> later;
+  ready.clear();
+  int activeCount = 0;
+  for (int pass = 0; pass < passCount; pass++) {
+    if (!passes[pass].culled) {
+      activeCount++;
+      if (dependencyCounts[pass] == 0) {
+        ready.push_back(pass);
+        std::push_heap(ready.begin(), ready.end(), later);
+      }
+    }
+  }
+
+  order.clear();
+  while (!ready.empty()) {
+    std::pop_heap(ready.begin(), ready.end(), later);
+    int pass = ready.back();
+    ready.pop_back();
+    order.push_back(pass);
+    for (int dependent : dependents[pass]) {
+      if (--dependencyCounts[dependent] == 0) {
+        ready.push_back(dependent);
+        std::push_heap(ready.begin(), ready.end(), later);
+      }
+    }
+  }
+
+  if ((int)order.size() != activeCount) {
+    for (int pass = 0; pass < passCount; pass++) {
+      if (!passes[pass].culled && dependencyCounts[pass] > 0) {
+        throw CycleError(passes[pass].name);
+      }
+    }
+  }
+}
+
+void dg::RenderGraph::Allocate() {
+  for (int position = 0; position < (int)order.size(); position++) {
+    const Pass &pass = passes[order[position]];
+    for (auto *list : {&pass.reads, &pass.writes}) {
+      for (Resource resource : *list) {
+        ResourceEntry &entry = resources[resource];
+        if (entry.firstUse < 0) {
+          entry.firstUse = position;
+        }
+        entry.lastUse = position;
+      }
+    }
+  }
+
+  transients.clear();
+  for (Resource resource = 0; resource < resourceCount; resource++) {
+    if (!resources[resource].imported && resources[resource].firstUse >= 0) {
+      transients.push_back(resource);
+    }
+  }
+  std::sort(transients.begin(), transients.end(),
+            [this](Resource a, Resource b) {
+              return resources[a].firstUse < resources[b].firstUse;
+            });
+
+  // Give each transient resource a physical framebuffer with the same
+  // options that's free by the time the resource is first used, acquiring
+  // one from the pool if there's none.
+  for (Resource resource : transients) {
+    ResourceEntry &entry = resources[resource];
+    PhysicalFrameBuffer *match = nullptr;
+    for (auto &physical : physicalFrameBuffers) {
+      if (physical.busyUntil < entry.firstUse &&
+          physical.framebuffer->GetOptions() == entry.options) {
+        match = &physical;
+        break;
+      }
+    }
+    if (match == nullptr) {
+      PhysicalFrameBuffer physical;
+      physical.framebuffer = ResourcePool::AcquireFrameBuffer(entry.options);
+      physical.size = entry.options.EstimatedMemorySize();
+      physicalFrameBuffers.push_back(physical);
+      match = &physicalFrameBuffers.back();
+    }
+    match->busyUntil = entry.lastUse;
+    entry.framebuffer = match->framebuffer;
+  }
+
+  statistics.transientResources = (int)transients.size();
+  statistics.physicalFrameBuffers = (int)physicalFrameBuffers.size();
+  statistics.allocatedBytes = 0;
+  for (const auto &physical : physicalFrameBuffers) {
+    statistics.allocatedBytes += physical.size;
+  }
+  statistics.unaliasedBytes = 0;
+  statistics.peakBytes = 0;
+  for (Resource resource : transients) {
+    statistics.unaliasedBytes +=
+        resources[resource].options.EstimatedMemorySize();
+  }
+  for (int position = 0; position < (int)order.size(); position++) {
+    size_t liveBytes = 0;
+    for (Resource resource : transients) {
+      const ResourceEntry &entry = resources[resource];
+      if (entry.firstUse <= position && position <= entry.lastUse) {
+        liveBytes += entry.options.EstimatedMemorySize();
+      }
+    }
+    statistics.peakBytes = std::max(statistics.peakBytes, liveBytes);
+  }
+}
+
+#pragma endregion
+#pragma region Execution
+
+void dg::RenderGraph::Execute() {
+  Cull();
+  Order();
+  Allocate();
+
+  statistics.passes = passCount;
+  statistics.culledPasses = passCount - (int)order.size();
+
+  for (int pass : order) {
+    passes[pass].execute(*this);
+  }
+}
+
+#pragma endregion
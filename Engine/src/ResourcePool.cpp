@@ -0,0 +1,143 @@
+//
+//  ResourcePool.cpp
+//
+
+#include "dg/ResourcePool.h"
+#include <algorithm>
+#include <cassert>
+
+std::unique_ptr<dg::ResourcePool> dg::ResourcePool::Instance = nullptr;
+
+void dg::ResourcePool::Initialize(uint64_t trimFrames) {
+  assert(Instance == nullptr);
+  Instance = std::unique_ptr<ResourcePool>(new ResourcePool(trimFrames));
+}
+
+void dg::ResourcePool::Shutdown() {
+  Instance = nullptr;
+}
+
+dg::ResourcePool::ResourcePool(uint64_t trimFrames) : trimFrames(trimFrames) {}
+
+std::shared_ptr<dg::FrameBuffer> dg::ResourcePool::AcquireFrameBuffer(
+    const FrameBuffer::Options &options) {
+  if (Instance == nullptr) {
+    return FrameBuffer::Create(options);
+  }
+  return Instance->Acquire(Instance->frameBuffers, options,
+                           [](const FrameBuffer::Options &options) {
+                             return FrameBuffer::Create(options);
+                           });
+}
+
+void dg::ResourcePool::ReleaseFrameBuffer(
+    const std::shared_ptr<FrameBuffer> &framebuffer) {
+  if (Instance != nullptr) {
+    Instance->Release(Instance->frameBuffers, framebuffer);
+  }
+}
+
+std::shared_ptr<dg::Texture> dg::ResourcePool::AcquireTexture(
+    const TextureOptions &options) {
+  if (Instance == nullptr) {
+    return Texture::Generate(options);
+  }
+  return Instance->Acquire(Instance->textures, options,
+                           [](const TextureOptions &options) {
+                             return Texture::Generate(options);
+                           });
+}
+
+void dg::ResourcePool::ReleaseTexture(const std::shared_ptr<Texture> &texture) {
+  if (Instance != nullptr) {
+    Instance->Release(Instance->textures, texture);
+  }
+}
+
+void dg::ResourcePool::EndFrame() {
+  if (Instance == nullptr) {
+    return;
+  }
+  Instance->Trim(Instance->frameBuffers);
+  Instance->Trim(Instance->textures);
+  Instance->frame++;
+}
+
+dg::ResourcePool::Statistics dg::ResourcePool::GetStatistics() {
+  if (Instance == nullptr) {
+    return Statistics();
+  }
+
+  Statistics statistics = Instance->statistics;
+  statistics.frameBuffers = (int)Instance->frameBuffers.size();
+  statistics.textures = (int)Instance->textures.size();
+  for (const auto &entry : Instance->frameBuffers) {
+    statistics.frameBuffersInUse += entry.inUse ? 1 : 0;
+    statistics.bytes += entry.size;
+  }
+  for (const auto &entry : Instance->textures) {
+    statistics.texturesInUse += entry.inUse ? 1 : 0;
+    statistics.bytes += entry.size;
+  }
+  return statistics;
+}
+
+template <typename Resource, typename Options, typename Create>
+std::shared_ptr<Resource> dg::ResourcePool::Acquire(
+    std::vector<Entry<Resource>> &entries, const Options &options,
+    const Create &create) {
+  statistics.acquired++;
+
+  for (auto &entry : entries) {
+    if (!entry.inUse && entry.resource->GetOptions() == options) {
+      entry.inUse = true;
+      entry.lastUsedFrame = frame;
+      return entry.resource;
+    }
+  }
+
+  Entry<Resource> entry;
+  entry.resource = create(options);
+  entry.size = options.EstimatedMemorySize();
+  entry.inUse = true;
+  entry.lastUsedFrame = frame;
+  entries.push_back(entry);
+  statistics.created++;
+  return entry.resource;
+}
+
+template <typename Resource>
+void dg::ResourcePool::Release(std::vector<Entry<Resource>> &entries,
+                               const std::shared_ptr<Resource> &resource) {
+  for (auto &entry : entries) {
+    if (entry.resource == resource) {
+      entry.inUse = false;
+      entry.lastUsedFrame = frame;
+      return;
+    }
+  }
+}
+
+template <typename Resource>
+void dg::ResourcePool::Trim(std::vector<Entry<Resource>> &entries) {
+  for (auto &entry : entries) {
+    // Nothing but the pool holds it, so it was dropped without being
+    // released.
+    if (entry.inUse && entry.resource.use_count() == 1) {
+      entry.inUse = false;
+    }
+    if (entry.inUse) {
+      entry.lastUsedFrame = frame;
+    }
+  }
+
+  size_t count = entries.size();
+  entries.erase(std::remove_if(entries.begin(), entries.end(),
+                               [this](const Entry<Resource> &entry) {
+                                 return !entry.inUse &&
+                                        frame - entry.lastUsedFrame >=
+                                            trimFrames;
+                               }),
+                entries.end());
+  statistics.trimmed += count - entries.size();
+}
@@ -5,16 +5,23 @@
 #include "dg/Scene.h"
 #include <algorithm>
 #include <cassert>
-#include <deque>
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
+#include <string>
 #include <vector>
 #include "dg/Camera.h"
+#include "dg/EngineTime.h"
 #include "dg/Exceptions.h"
 #include "dg/FrameBuffer.h"
 #include "dg/Graphics.h"
+#include "dg/JobSystem.h"
 #include "dg/Lights.h"
 #include "dg/Model.h"
 #include "dg/RasterizerState.h"
+#include "dg/ResourcePool.h"
+#include "dg/Shader.h"
 #include "dg/ShaderReplacedMaterial.h"
 #include "dg/Skybox.h"
 #include "dg/Window.h"
@@ -23,6 +30,68 @@
 #include "dg/vr/VRRenderModel.h"
 #include "dg/vr/VRTrackedObject.h"
 
+namespace {
+
+  // Farthest a spot or point light's shadow reaches, for lights whose
+  // brightness never falls off.
+  const float LocalShadowFarClip = 100;
+
+  const float PointShadowNearClip = 0.05f;
+
+  // View directions and up vectors of the faces of a cube map, in the order
+  // of its layers.
+  const glm::vec3 CubeFaceDirections[6] = {
+      {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1},
+  };
+  const glm::vec3 CubeFaceUps[6] = {
+      {0, -1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}, {0, -1, 0}, {0, -1, 0},
+  };
+
+  // Render graph names of the point lights' shadow cubes. The graph needs
+  // names that outlive the frame.
+  const char *const ShadowCubeNames[] = {
+      "ShadowCube0", "ShadowCube1", "ShadowCube2", "ShadowCube3",
+  };
+  static_assert(sizeof(ShadowCubeNames) / sizeof(ShadowCubeNames[0]) ==
+                    dg::Light::MAX_SHADOW_CUBES,
+                "Every shadow cube needs a name.");
+
+  // Bounds a model by its mesh's bounding sphere in scene space, as
+  // (center, radius).
+  glm::vec4 SceneSpaceBounds(const dg::Model &model) {
+    const glm::mat4x4 &xf = model.CachedSceneSpaceMatrix();
+    if (model.mesh == nullptr) {
+      return glm::vec4(glm::vec3(xf[3]), 0);
+    }
+    float scale = std::max({glm::length(glm::vec3(xf[0])),
+                            glm::length(glm::vec3(xf[1])),
+                            glm::length(glm::vec3(xf[2]))});
+    glm::vec3 center(xf * glm::vec4(model.mesh->GetBoundsCenter(), 1));
+    return glm::vec4(center, model.mesh->GetBoundsRadius() * scale);
+  }
+
+  // Whether a sphere, as (center, radius), overlaps the view volume of a
+  // view-projection matrix. Conservative near the volume's corners.
+  bool SphereInFrustum(const glm::mat4x4 &viewProjection,
+                       const glm::vec4 &sphere) {
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+      rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i],
+                          viewProjection[2][i], viewProjection[3][i]);
+    }
+    for (int i = 0; i < 6; i++) {
+      glm::vec4 plane = (i % 2 == 0) ? rows[3] + rows[i / 2]
+                                     : rows[3] - rows[i / 2];
+      float distance = glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w;
+      if (distance < -sphere.w * glm::length(glm::vec3(plane))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+} // namespace
+
 dg::Scene::Scene() : SceneObject() {}
 dg::Scene::~Scene() {}
 
@@ -116,20 +185,129 @@ void dg::Scene::InitializeVR() {
 }
 
 void dg::Scene::Update() {
-  // Traverse the scene hierarchy and update all behaviors on all objects.
-  std::forward_list<SceneObject*> remainingObjects;
-  remainingObjects.push_front((SceneObject*)this);
+  // Collect parallel behaviors into their batches. See
+  // Behavior::GetUpdateAccess() for how they're ordered.
+  FrameVector<SceneObject *> writingObjects(updateArena);
+  FrameVector<Behavior *> readingBehaviors(updateArena);
+  FrameVector<Behavior *> serialBehaviors(updateArena);
+  FrameVector<SceneObject *> remainingObjects(updateArena);
+  remainingObjects.push_back((SceneObject*)this);
   while (!remainingObjects.empty()) {
-    SceneObject *obj = remainingObjects.front();
-    remainingObjects.pop_front();
+    SceneObject *obj = remainingObjects.back();
+    remainingObjects.pop_back();
+    for (const auto &behavior : obj->Behaviors()) {
+      if (!behavior->enabled) continue;
+      Behavior::UpdateAccess access = behavior->GetUpdateAccess();
+      if (!access.parallel) continue;
+      if (!access.readsTransforms) {
+        if (writingObjects.empty() || writingObjects.back() != obj) {
+          writingObjects.push_back(obj);
+        }
+      } else if (!access.writesTransform) {
+        readingBehaviors.push_back(behavior.get());
+      } else {
+        serialBehaviors.push_back(behavior.get());
+      }
+    }
+    for (auto child = obj->Children().begin();
+         child != obj->Children().end();
+         child++) {
+      if (*child == nullptr || !(*child)->enabled) continue;
+      remainingObjects.push_back(child->get());
+    }
+  }
+
+  JobSystem::ParallelFor(
+      writingObjects.size(), 64, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+          for (const auto &behavior : writingObjects[i]->Behaviors()) {
+            if (!behavior->enabled) continue;
+            Behavior::UpdateAccess access = behavior->GetUpdateAccess();
+            if (access.parallel && !access.readsTransforms) {
+              behavior->Update();
+            }
+          }
+        }
+      });
+  JobSystem::ParallelFor(
+      readingBehaviors.size(), 64, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+          readingBehaviors[i]->Update();
+        }
+      });
+  for (Behavior *behavior : serialBehaviors) {
+    behavior->Update();
+  }
+  // When pipelined, deferred changes wait until rendering is done.
+  if (!pipelined) {
+    Behavior::RunDeferred();
+  }
+
+  // Traverse the scene hierarchy and update all main-thread behaviors on all
+  // objects.
+  remainingObjects.push_back((SceneObject*)this);
+  while (!remainingObjects.empty()) {
+    SceneObject *obj = remainingObjects.back();
+    remainingObjects.pop_back();
     obj->UpdateBehaviors();
     for (auto child = obj->Children().begin();
          child != obj->Children().end();
          child++) {
-      if (!(*child)->enabled) continue;
-      remainingObjects.push_front(child->get());
+      if (*child == nullptr || !(*child)->enabled) continue;
+      remainingObjects.push_back(child->get());
     }
   }
+
+  // When pipelined, deferred changes wait until rendering is done.
+  if (!pipelined) {
+    Behavior::RunDeferred();
+  }
+
+  remainingObjects = FrameVector<SceneObject *>();
+  writingObjects = FrameVector<SceneObject *>();
+  readingBehaviors = FrameVector<Behavior *>();
+  serialBehaviors = FrameVector<Behavior *>();
+  updateArena.Reset();
+}
+
+void dg::Scene::UpdateSimulation() {
+  assert(pipelined);
+  for (int step = 0; step < pipelinedSteps; step++) {
+    Update();
+  }
+  sceneSpaceCache.Update();
+  sceneSpaceCache.Publish();
+}
+
+void dg::Scene::SynchronizePipeline() {
+  if (!pipelined) {
+    pipelined = true;
+    sceneSpaceCache.SetPipelined(true);
+  }
+
+  sceneSpaceCache.SetStructureLocked(false);
+  Behavior::RunDeferred();
+  JobSystem::RunMainThreadTasks();
+
+  // Without a snapshot matching the current hierarchy, either because it
+  // changed or because it's the first frame, make one now.
+  if (sceneSpaceCache.IsStale()) {
+    sceneSpaceCache.Rebuild(*this);
+    RebuildRegistry();
+  }
+  if (!sceneSpaceCache.Acquire()) {
+    sceneSpaceCache.Update();
+    sceneSpaceCache.Publish();
+    sceneSpaceCache.Acquire();
+  }
+  sceneSpaceCache.SetStructureLocked(true);
+
+  // Take the next update's time steps here, so that Time isn't written
+  // while rendering reads it.
+  pipelinedSteps = 0;
+  while (Time::Step()) {
+    pipelinedSteps++;
+  }
 }
 
 void dg::Scene::ClearBuffer() {
@@ -189,6 +367,14 @@ void dg::Scene::SetupSubrender(Subrender &subrender) {
       subrender.camera->aspectRatio = subrender.framebuffer->GetAspectRatio();
     }
   }
+  if (subrender.viewport.z > 0 && subrender.viewport.w > 0) {
+    Graphics::Instance->SetViewport(subrender.viewport.x, subrender.viewport.y,
+                                    subrender.viewport.z, subrender.viewport.w);
+    if (subrender.camera != nullptr) {
+      subrender.camera->aspectRatio =
+          (float)subrender.viewport.z / subrender.viewport.w;
+    }
+  }
 
   // Always use the main subrender's rasterizer state as the base rasterizer
   // state, and derive off of that.
@@ -204,9 +390,15 @@ void dg::Scene::SetupSubrender(Subrender &subrender) {
   rasterizerState += subrender.rasterizerState;
   Graphics::Instance->PushRasterizerState(rasterizerState);
 
-  // Clear the background and depth and stencil buffers.
+  // Clear the background and depth and stencil buffers, within the
+  // viewport if there is one.
   if (subrender.clearBuffer) {
+    Graphics::Instance->SetClearRegion(subrender.viewport.x,
+                                       subrender.viewport.y,
+                                       subrender.viewport.z,
+                                       subrender.viewport.w);
     ClearBuffer();
+    Graphics::Instance->SetClearRegion(0, 0, 0, 0);
   }
 
   // If we're rendering to HMD, draw the hidden area mesh for early-out of
@@ -229,29 +421,75 @@ void dg::Scene::TeardownRender() {
   if (vr.enabled) {
     VRManager::Instance->RenderFinished();
   }
-  currentRender.models.clear();
-  currentRender.lights.clear();
-  currentRender.shadowCastingLight = nullptr;
+  // Release the per-frame containers before the memory backing them.
+  currentRender.models = FrameVector<SortedModel>();
+  currentRender.lights = FrameVector<Light *>();
+  currentRender.drawCommands = FrameVector<DrawCommand>();
+  currentRender.mainPassInputs = FrameVector<RenderGraph::Resource>();
+  currentRender.hasDrawCommands = false;
+  currentRender.shadowCastingLights = FrameVector<Light *>();
+  currentRender.shadowMap = nullptr;
+  currentRender.cascadedLight = nullptr;
+  currentRender.shadowCascades = nullptr;
+  currentRender.shadowCubeLights = FrameVector<Light *>();
+  for (auto &shadowCube : currentRender.shadowCubes) {
+    shadowCube = nullptr;
+  }
   currentRender.rendering = false;
+  frameArena.Reset();
 }
 
 void dg::Scene::RenderFrame() {
   subrenders.main.camera = cameras.main;
   PreRender();
   SetupRender();
-  RenderLightShadowMap();
-  RenderFramebuffers();
+
+  renderGraph.Reset();
+  currentRender.mainPassInputs =
+      FrameVector<RenderGraph::Resource>(frameArena);
+  AddShadowPass();
+  AddRenderPasses(renderGraph);
+  AddMainPasses();
+  renderGraph.AddPass(
+      "PostProcess",
+      [](RenderGraph::PassBuilder &builder) { builder.SideEffect(); },
+      [this](RenderGraph &graph) { PostProcess(); });
+  renderGraph.Execute();
+
+  TeardownRender();
+  PostRender();
+  ResourceReadback();
+}
+
+void dg::Scene::AddRenderPasses(RenderGraph &graph) {
+  // Scenes that haven't described their framebuffers to the graph may render
+  // to anything, so this pass can never be culled.
+  graph.AddPass(
+      "Framebuffers",
+      [](RenderGraph::PassBuilder &builder) { builder.SideEffect(); },
+      [this](RenderGraph &graph) { RenderFramebuffers(); });
+}
+
+void dg::Scene::AddMainPasses() {
+  auto setup = [this](RenderGraph::PassBuilder &builder) {
+    for (RenderGraph::Resource resource : currentRender.mainPassInputs) {
+      builder.Read(resource);
+    }
+    builder.SideEffect();
+  };
+
   if (vr.enabled) {
     for (int i = 0; i < 2; i++) {
-      subrenders.eyes[i].camera = cameras.vr;
-      PerformSubrender(subrenders.eyes[i]);
+      renderGraph.AddPass(i == 0 ? "LeftEye" : "RightEye", setup,
+                          [this, i](RenderGraph &graph) {
+                            subrenders.eyes[i].camera = cameras.vr;
+                            PerformSubrender(subrenders.eyes[i]);
+                          });
     }
   }
-  PerformSubrender(subrenders.main);
-  PostProcess();
-  TeardownRender();
-  PostRender();
-  ResourceReadback();
+  renderGraph.AddPass("Main", setup, [this](RenderGraph &graph) {
+    PerformSubrender(subrenders.main);
+  });
 }
 
 void dg::Scene::PerformSubrender(Subrender &subrender) {
@@ -290,38 +528,46 @@ void dg::Scene::PerformSubrender(Subrender &subrender) {
 }
 
 void dg::Scene::ProcessSceneHierarchy() {
-  currentRender.models.clear();
-  currentRender.lights.clear();
+  currentRender.models = FrameVector<SortedModel>(frameArena);
+  currentRender.lights = FrameVector<Light *>(frameArena);
+  currentRender.hasDrawCommands = false;
 
-  // Recursively cache the scene-space transforms of all SceneObjects.
-  CacheSceneSpace();
+  // Cache the scene-space transforms of all SceneObjects. Only objects whose
+  // transforms changed since last frame are recomputed. When pipelined, the
+  // cache was already updated and synchronized before rendering.
+  if (!pipelined) {
+    if (sceneSpaceCache.IsStale()) {
+      sceneSpaceCache.Rebuild(*this);
+      RebuildRegistry();
+    }
+    sceneSpaceCache.Update();
+  }
 
-  // Traverse scene tree and sort out different types of objects
-  // into their own lists.
-  std::deque<SceneObject*> remainingObjects;
-  remainingObjects.push_front((SceneObject*)this);
-  while (!remainingObjects.empty()) {
-    SceneObject *obj = remainingObjects.front();
-    remainingObjects.pop_front();
-    for (auto child = obj->Children().begin();
-         child != obj->Children().end();
-         child++) {
-      if (!(*child)->enabled) continue;
-      remainingObjects.push_front(child->get());
-      if (auto model = std::dynamic_pointer_cast<Model>(*child)) {
-        currentRender.models.push_back(SortedModel(*model));
-      } else if (auto light = std::dynamic_pointer_cast<Light>(*child)) {
-        currentRender.lights.push_front(light.get());
-      }
+  // Collect the active models and lights. Reserve up front so the vectors
+  // don't leave abandoned buffers in the frame arena as they grow.
+  currentRender.models.reserve(registry.models.size());
+  currentRender.lights.reserve(registry.lights.size());
+  for (auto &entry : registry.models) {
+    if (sceneSpaceCache.IsActive(entry.second)) {
+      currentRender.models.push_back(SortedModel(*entry.first));
+    }
+  }
+  for (auto &entry : registry.lights) {
+    if (sceneSpaceCache.IsActive(entry.second)) {
+      currentRender.lights.push_back(entry.first);
     }
   }
 
   // Compute all models' distances to camera.
   glm::vec3 cameraPos = cameras.main->CachedSceneSpace().translation;
-  for (SortedModel &sortedModel : currentRender.models) {
-    sortedModel.distanceToCamera = glm::distance(
-        sortedModel.model->CachedSceneSpace().translation, cameraPos);
-  }
+  JobSystem::ParallelFor(
+      currentRender.models.size(), 1024, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+          SortedModel &sortedModel = currentRender.models[i];
+          sortedModel.distanceToCamera = glm::distance(
+              sortedModel.model->CachedSceneSpace().translation, cameraPos);
+        }
+      });
 
   // Sort models.
   std::sort(currentRender.models.begin(), currentRender.models.end(),
@@ -332,80 +578,534 @@ void dg::Scene::ProcessSceneHierarchy() {
          }
 
          // Then short by distance to camera. If render queue is
-         // < Transparent, draw objects closer to camera first (for early-out
+         // < Transparent, group objects by shader to minimize program
+         // switches, and draw objects closer to camera first (for early-out
          // in fragment shader). Otherwise, draw from back to front for
          // transparency.
          if (a.model->material->queue < RenderQueue::Transparent) {
+           if (a.model->material->shader != b.model->material->shader) {
+             return a.model->material->shader < b.model->material->shader;
+           }
            return a.distanceToCamera < b.distanceToCamera;
          } else {
            return a.distanceToCamera > b.distanceToCamera;
          }
        });
 
-  // Reset light shadows.
-  bool foundShadowLight = false;
-  currentRender.shadowCastingLight = nullptr;
+  // Reset light shadows, and collect the lights that will cast them.
+  currentRender.shadowCastingLights = FrameVector<Light *>(frameArena);
+  currentRender.cascadedLight = nullptr;
+  currentRender.shadowCubeLights = FrameVector<Light *>(frameArena);
   for (auto &light : currentRender.lights) {
     light->SetShadowMap(nullptr);
-    if (light->GetCastShadows()) {
-      if (foundShadowLight) {
-        std::cerr
-            << "Warning: More than one light wants to cast shadows, but only "
-               "one shadow is supported at a time."
-            << std::endl;
-      } else {
-        foundShadowLight = true;
-        currentRender.shadowCastingLight = light;
-      }
+    if (!light->GetCastShadows()) {
+      continue;
+    }
+    switch (light->GetShaderData().type) {
+      case Light::LightType::NONE:
+        break;
+      case Light::LightType::POINT:
+#if defined(_OPENGL)
+        currentRender.shadowCubeLights.push_back(light);
+#else
+        std::cerr << "Error: Shadows are not implemented for PointLight."
+                  << std::endl;
+#endif
+        break;
+      case Light::LightType::DIRECTIONAL:
+#if defined(_OPENGL)
+        // Cascades are drawn with a geometry shader, which the DirectX
+        // build doesn't support yet.
+        if (currentRender.cascadedLight == nullptr &&
+            shadows.cascadeCount > 0) {
+          currentRender.cascadedLight = light;
+          break;
+        }
+#endif
+        currentRender.shadowCastingLights.push_back(light);
+        break;
+      case Light::LightType::SPOT:
+        currentRender.shadowCastingLights.push_back(light);
+        break;
     }
   }
+
+  // Keep the point lights whose shadows cover the most of the screen, as
+  // only so many shadow cubes can be bound at once.
+  auto &cubeLights = currentRender.shadowCubeLights;
+  if (cubeLights.size() > Light::MAX_SHADOW_CUBES) {
+    std::stable_sort(cubeLights.begin(), cubeLights.end(),
+                     [this](const Light *a, const Light *b) {
+                       return ShadowCoverage(*a) > ShadowCoverage(*b);
+                     });
+    std::cerr << "Warning: Only " << Light::MAX_SHADOW_CUBES
+              << " point lights can cast shadows, so "
+              << cubeLights.size() - Light::MAX_SHADOW_CUBES
+              << " light(s) cast no shadow." << std::endl;
+    cubeLights.resize(Light::MAX_SHADOW_CUBES);
+  }
 }
 
-void dg::Scene::RenderLightShadowMap() {
-  if (currentRender.shadowCastingLight == nullptr) {
-    return;
+void dg::Scene::RebuildRegistry() {
+  registry.models.clear();
+  registry.lights.clear();
+  for (int slot = 0; slot < (int)sceneSpaceCache.Size(); slot++) {
+    SceneObject *object = sceneSpaceCache.Object(slot);
+    if (auto model = dynamic_cast<Model *>(object)) {
+      registry.models.emplace_back(model, slot);
+    } else if (auto light = dynamic_cast<Light *>(object)) {
+      registry.lights.emplace_back(light, slot);
+    }
   }
+}
 
-  switch (currentRender.shadowCastingLight->GetShaderData().type) {
-    case Light::LightType::NONE:
-      return;
-    case Light::LightType::POINT:
-      std::cerr << "Error: Shadows are not implemented for PointLight."
-                << std::endl;
-      return;
-    case Light::LightType::SPOT:
-      break;
-    case Light::LightType::DIRECTIONAL:
-      std::cerr << "Error: Shadows are not implemented for DirectionalLight."
-                << std::endl;
-      return;
+void dg::Scene::AddShadowPass() {
+  if (currentRender.cascadedLight != nullptr) {
+    FrameBuffer::Options options;
+    options.width = shadows.cascadeResolution;
+    options.height = shadows.cascadeResolution;
+    options.depthReadable = true;
+    options.hasColor = false;
+    options.hasStencil = false;
+    options.type = TextureType::_2D_ARRAY;
+    options.layers = (unsigned int)std::min(shadows.cascadeCount,
+                                            ShadowCascades::MaxCascades);
+    RenderGraph::Resource cascadeMap =
+        renderGraph.CreateFrameBuffer("ShadowCascades", options);
+
+    renderGraph.AddPass(
+        "ShadowCascades",
+        [cascadeMap](RenderGraph::PassBuilder &builder) {
+          builder.Write(cascadeMap);
+        },
+        [this, cascadeMap](RenderGraph &graph) {
+          RenderShadowCascades(*graph.GetFrameBuffer(cascadeMap));
+        });
+    currentRender.mainPassInputs.push_back(cascadeMap);
   }
 
-  if (subrenders.light.framebuffer == nullptr) {
+  // Each point light's shadow cube is its own layered framebuffer, since
+  // cube map arrays need a newer GLSL than shaders target.
+  for (size_t i = 0; i < currentRender.shadowCubeLights.size(); i++) {
     FrameBuffer::Options options;
-    options.width = 2048;
-    options.height = 2048;
+    options.width = shadows.cubeResolution;
+    options.height = shadows.cubeResolution;
     options.depthReadable = true;
     options.hasColor = false;
     options.hasStencil = false;
-    subrenders.light.framebuffer = FrameBuffer::Create(options);
+    options.type = TextureType::CUBEMAP;
+    RenderGraph::Resource cubeMap =
+        renderGraph.CreateFrameBuffer(ShadowCubeNames[i], options);
+
+    // Capturing little enough for std::function to store it in place.
+    int index = (int)i;
+    renderGraph.AddPass(
+        ShadowCubeNames[i],
+        [cubeMap](RenderGraph::PassBuilder &builder) {
+          builder.Write(cubeMap);
+        },
+        [this, index, cubeMap](RenderGraph &graph) {
+          RenderShadowCube(*currentRender.shadowCubeLights[index], index,
+                           *graph.GetFrameBuffer(cubeMap));
+        });
+    currentRender.mainPassInputs.push_back(cubeMap);
+  }
+
+  if (currentRender.shadowCastingLights.empty()) {
+    return;
+  }
+
+  // Scenes may provide their own shadow atlas framebuffer, e.g. to visualize
+  // it. Otherwise, it's transient.
+  RenderGraph::Resource shadowMap;
+  if (subrenders.light.framebuffer != nullptr) {
+    shadowMap = renderGraph.ImportFrameBuffer("ShadowMap",
+                                              subrenders.light.framebuffer);
+  } else {
+    FrameBuffer::Options options;
+    options.width = shadows.atlasSize;
+    options.height = shadows.atlasSize;
+    options.depthReadable = true;
+    options.hasColor = false;
+    options.hasStencil = false;
+    shadowMap = renderGraph.CreateFrameBuffer("ShadowMap", options);
+  }
+
+  renderGraph.AddPass(
+      "Shadow",
+      [shadowMap](RenderGraph::PassBuilder &builder) {
+        builder.Write(shadowMap);
+      },
+      [this, shadowMap](RenderGraph &graph) {
+        RenderShadowAtlas(graph.GetFrameBuffer(shadowMap));
+      });
+  currentRender.mainPassInputs.push_back(shadowMap);
+}
+
+void dg::Scene::RenderShadowAtlas(std::shared_ptr<FrameBuffer> framebuffer) {
+  // Size each light's tile by how much of the screen its shadow covers, and
+  // pack them largest first, as the atlas requires.
+  FrameVector<ShadowTile> tiles(frameArena);
+  tiles.reserve(currentRender.shadowCastingLights.size());
+  shadowAtlas.Reset((int)framebuffer->GetWidth(),
+                    (int)framebuffer->GetHeight());
+  for (Light *light : currentRender.shadowCastingLights) {
+    ShadowTile shadowTile;
+    shadowTile.light = light;
+    shadowTile.tile.size =
+        shadowAtlas.TileSizeForCoverage(ShadowCoverage(*light));
+    tiles.push_back(shadowTile);
+  }
+  std::stable_sort(tiles.begin(), tiles.end(),
+                   [](const ShadowTile &a, const ShadowTile &b) {
+                     return a.tile.size > b.tile.size;
+                   });
+
+  // Lights that don't fit get smaller tiles, or no shadow at all once not
+  // even the smallest tile fits.
+  int maxSize = shadowAtlas.GetSize();
+  int droppedCount = 0;
+  for (ShadowTile &shadowTile : tiles) {
+    int size = std::min(shadowTile.tile.size, maxSize);
+    bool allocated = shadowAtlas.Allocate(size, shadowTile.tile);
+    while (!allocated && size > ShadowAtlas::MinTileSize) {
+      size /= 2;
+      allocated = shadowAtlas.Allocate(size, shadowTile.tile);
+    }
+    if (!allocated) {
+      shadowTile.tile.size = 0;
+      droppedCount++;
+    } else {
+      maxSize = size;
+    }
+  }
+  if (droppedCount > 0) {
+    std::cerr << "Warning: The shadow atlas is full, so " << droppedCount
+              << " light(s) cast no shadow." << std::endl;
   }
 
-  auto *spotlight = static_cast<SpotLight *>(currentRender.shadowCastingLight);
+  // Render into the graph's framebuffer without keeping it, so that next
+  // frame still knows whether the scene provided its own. With static
+  // shadows cached, the atlas starts as a copy of the cache, and only
+  // dynamic models are drawn over it.
+  auto sceneFramebuffer = subrenders.light.framebuffer;
+  bool clearBuffer = subrenders.light.clearBuffer;
+  if (shadows.cacheStatic) {
+    RenderStaticShadows(*framebuffer, tiles);
+    subrenders.light.modelFilter = Subrender::ModelFilter::Dynamic;
+    subrenders.light.clearBuffer = false;
+  } else if (shadowCache.framebuffer != nullptr) {
+    ResourcePool::ReleaseFrameBuffer(shadowCache.framebuffer);
+    shadowCache.framebuffer = nullptr;
+    shadowCache.lights.clear();
+    shadowCache.casters.clear();
+  }
+  subrenders.light.framebuffer = framebuffer;
+  for (const ShadowTile &shadowTile : tiles) {
+    if (shadowTile.tile.size == 0) {
+      continue;
+    }
+    SetupShadowCamera(*shadowTile.light);
+    subrenders.light.viewport =
+        glm::ivec4(shadowTile.tile.x, shadowTile.tile.y, shadowTile.tile.size,
+                   shadowTile.tile.size);
+    PerformSubrender(subrenders.light);
+  }
+  subrenders.light.framebuffer = sceneFramebuffer;
+  subrenders.light.clearBuffer = clearBuffer;
+  subrenders.light.modelFilter = Subrender::ModelFilter::All;
+  subrenders.light.viewport = glm::ivec4(0);
+
+  // Only hand out the atlas once it's complete, so that no light's
+  // subrender samples the atlas it's drawing to.
+  currentRender.shadowMap = framebuffer->GetDepthTexture();
+  for (const ShadowTile &shadowTile : tiles) {
+    if (shadowTile.tile.size != 0) {
+      shadowTile.light->SetShadowMap(currentRender.shadowMap,
+                                     shadowAtlas.GetRect(shadowTile.tile));
+    }
+  }
+}
+
+void dg::Scene::RenderStaticShadows(FrameBuffer &atlas,
+                                    const FrameVector<ShadowTile> &tiles) {
+  // Keep the cache in the atlas's size and format, so that it can be copied
+  // straight into it.
+  if (shadowCache.framebuffer == nullptr ||
+      shadowCache.framebuffer->GetOptions() != atlas.GetOptions()) {
+    if (shadowCache.framebuffer != nullptr) {
+      ResourcePool::ReleaseFrameBuffer(shadowCache.framebuffer);
+    }
+    shadowCache.framebuffer =
+        ResourcePool::AcquireFrameBuffer(atlas.GetOptions());
+    shadowCache.lights.clear();
+  }
+  shadowCache.frame++;
+
+  // Find the bounds of static models that moved, appeared, or disappeared
+  // since last frame, both where they were and where they are.
+  FrameVector<glm::vec4> changes(frameArena);
+  for (const SortedModel &sortedModel : currentRender.models) {
+    const Model &model = *sortedModel.model;
+    if (!model.isStatic || !(model.layer & subrenders.light.layerMask)) {
+      continue;
+    }
+    auto &caster = shadowCache.casters[&model];
+    const glm::mat4x4 &matrix = model.CachedSceneSpaceMatrix();
+    if (caster.frame == 0 || caster.matrix != matrix) {
+      if (caster.frame != 0) {
+        changes.push_back(caster.bounds);
+      }
+      caster.matrix = matrix;
+      caster.bounds = SceneSpaceBounds(model);
+      changes.push_back(caster.bounds);
+    }
+    caster.frame = shadowCache.frame;
+  }
+  for (auto it = shadowCache.casters.begin();
+       it != shadowCache.casters.end();) {
+    if (it->second.frame != shadowCache.frame) {
+      changes.push_back(it->second.bounds);
+      it = shadowCache.casters.erase(it);
+    } else {
+      it++;
+    }
+  }
+
+  // Draw the static models of each light whose cached tile is out of date.
+  auto sceneFramebuffer = subrenders.light.framebuffer;
+  subrenders.light.framebuffer = shadowCache.framebuffer;
+  subrenders.light.modelFilter = Subrender::ModelFilter::Static;
+  for (const ShadowTile &shadowTile : tiles) {
+    if (shadowTile.tile.size == 0) {
+      continue;
+    }
+    SetupShadowCamera(*shadowTile.light);
+    const glm::mat4x4 &lightTransform = shadowTile.light->GetLightTransform();
+    auto &entry = shadowCache.lights[shadowTile.light];
+    bool valid = entry.frame != 0 && entry.tile == shadowTile.tile &&
+                 entry.lightTransform == lightTransform;
+    for (size_t i = 0; valid && i < changes.size(); i++) {
+      valid = !SphereInFrustum(lightTransform, changes[i]);
+    }
+    entry.frame = shadowCache.frame;
+    if (valid) {
+      shadowCache.reusedTiles++;
+      continue;
+    }
+    shadowCache.redrawnTiles++;
+
+    entry.tile = shadowTile.tile;
+    entry.lightTransform = lightTransform;
+    subrenders.light.viewport =
+        glm::ivec4(shadowTile.tile.x, shadowTile.tile.y, shadowTile.tile.size,
+                   shadowTile.tile.size);
+    PerformSubrender(subrenders.light);
+  }
+  subrenders.light.framebuffer = sceneFramebuffer;
+
+  // Forget lights that no longer cast shadows.
+  for (auto it = shadowCache.lights.begin(); it != shadowCache.lights.end();) {
+    if (it->second.frame != shadowCache.frame) {
+      it = shadowCache.lights.erase(it);
+    } else {
+      it++;
+    }
+  }
+
+  Graphics::Instance->CopyFrameBuffer(*shadowCache.framebuffer, atlas);
+}
+
+void dg::Scene::RenderShadowCascades(FrameBuffer &framebuffer) {
+  Light &light = *currentRender.cascadedLight;
+  int count = (int)framebuffer.GetOptions().layers;
+  shadowCascades.Fit(*cameras.main, light, count, shadows.directionalDistance,
+                     shadows.cascadeSplitBlend, (int)framebuffer.GetWidth());
+
+  static_assert(ShadowCascades::MaxCascades <= MaxShadowLayers,
+                "Every cascade must be a layer of one shadow map.");
+  glm::mat4x4 transforms[ShadowCascades::MaxCascades];
+  for (int cascade = 0; cascade < count; cascade++) {
+    transforms[cascade] = shadowCascades.GetTransform(cascade);
+  }
+  DrawLayeredShadowCasters(framebuffer, transforms, count);
+
+  shadowCascades.SetShadowMap(framebuffer.GetDepthTexture());
+  currentRender.shadowCascades = &shadowCascades;
+  light.SetShadowCascades(framebuffer.GetDepthTexture());
+}
+
+void dg::Scene::RenderShadowCube(Light &light, int index,
+                                 FrameBuffer &framebuffer) {
+  // Every face shares a 90 degree projection out to the light's range.
+  Light::ShaderData data = light.GetShaderData();
+  glm::mat4x4 projection =
+      glm::perspective(glm::half_pi<float>(), 1.f, PointShadowNearClip,
+                       std::min(Light::Range(data), LocalShadowFarClip));
+  glm::mat4x4 transforms[6];
+  for (int face = 0; face < 6; face++) {
+    transforms[face] =
+        projection * glm::lookAt(data.position,
+                                 data.position + CubeFaceDirections[face],
+                                 CubeFaceUps[face]);
+  }
+  DrawLayeredShadowCasters(framebuffer, transforms, 6);
+
+  currentRender.shadowCubes[index] = framebuffer.GetDepthTexture();
+  light.SetLightTransform(projection);
+  light.SetShadowCube(currentRender.shadowCubes[index], index);
+}
+
+void dg::Scene::DrawLayeredShadowCasters(FrameBuffer &framebuffer,
+                                         const glm::mat4x4 *transforms,
+                                         int count) {
+  assert(count > 0 && count <= MaxShadowLayers);
+
+  // Find which layers each model can cast a shadow into. The geometry
+  // shader only sends a model's triangles to the layers it reaches.
+  const auto &models = currentRender.models;
+  FrameVector<int> layerMasks(models.size(), frameArena);
+  JobSystem::ParallelFor(
+      models.size(), 256, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+          const Model &model = *models[i].model;
+          layerMasks[i] = 0;
+          if (model.mesh == nullptr ||
+              !(model.layer & subrenders.light.layerMask)) {
+            continue;
+          }
+          glm::vec4 bounds = SceneSpaceBounds(model);
+          for (int layer = 0; layer < count; layer++) {
+            if (SphereInFrustum(transforms[layer], bounds)) {
+              layerMasks[i] |= 1 << layer;
+            }
+          }
+        }
+      });
+
+  if (layeredCasterMaterial == nullptr) {
+    layeredCasterMaterial = std::make_shared<Material>();
+    layeredCasterMaterial->shader =
+        Shader::FromFiles("assets/shaders/shadowcaster.v.glsl",
+                          "assets/shaders/shadowlayers.g.glsl",
+                          "assets/shaders/shadowcaster.f.glsl");
+  }
+
+  // Draw with the light subrender's rasterizer state, as a Depthmap
+  // subrender would, clearing every layer at once.
+  Graphics::Instance->SetRenderTarget(framebuffer);
+  RasterizerState rasterizerState = subrenders.main.rasterizerState;
+  rasterizerState += subrenders.framebuffer.rasterizerState;
+  rasterizerState += subrenders.light.rasterizerState;
+  Graphics::Instance->PushRasterizerState(rasterizerState);
+  Graphics::Instance->ClearDepthStencil(true, false);
+
+  Material *material = layeredCasterMaterial.get();
+  Model::DrawContext context;
+  Model::BeginMaterial(context, material);
+  // The names are built once, since they're too long for std::string's
+  // small buffer and would allocate every frame.
+  static const std::vector<std::string> layerTransformNames = [] {
+    std::vector<std::string> names;
+    for (int layer = 0; layer < MaxShadowLayers; layer++) {
+      names.push_back("_LayerTransforms[" + std::to_string(layer) + "]");
+    }
+    return names;
+  }();
+  material->shader->SetInt("_LayerCount", count);
+  for (int layer = 0; layer < count; layer++) {
+    material->shader->SetMat4(layerTransformNames[layer], transforms[layer]);
+  }
+  for (size_t i = 0; i < models.size(); i++) {
+    if (layerMasks[i] == 0) {
+      continue;
+    }
+    material->shader->SetInt("_LayerMask", layerMasks[i]);
+    models[i].model->DrawWithMaterial(context, material);
+  }
+  Model::EndMaterial(material);
+  Graphics::Instance->PopRasterizerState();
+}
+
+void dg::Scene::InvalidateShadowCache() {
+  shadowCache.lights.clear();
+}
+
+void dg::Scene::SetupShadowCamera(Light &light) {
+  Light::ShaderData data = light.GetShaderData();
   auto camera = subrenders.light.camera;
-  camera->transform = spotlight->CachedSceneSpace();
-  camera->fov = spotlight->GetCutoff() * 2;
-  camera->nearClip = 0.01f;
-  camera->farClip = 100;
-  currentRender.shadowCastingLight->SetLightTransform(
-      camera->GetProjectionMatrix() * camera->GetViewMatrix());
-  PerformSubrender(subrenders.light);
-  currentRender.shadowCastingLight->SetShadowMap(
-      subrenders.light.framebuffer->GetDepthTexture());
+  camera->aspectRatio = 1;
+  switch (data.type) {
+    case Light::LightType::SPOT:
+      camera->projection = Camera::Projection::Perspective;
+      camera->transform = light.CachedSceneSpace();
+      camera->fov = data.outerCutoff * 2;
+      camera->nearClip = 0.01f;
+      camera->farClip = std::min(Light::Range(data), LocalShadowFarClip);
+      break;
+    case Light::LightType::DIRECTIONAL: {
+      // Look down on the part of the main camera's view that gets shadows,
+      // from far enough back to catch casters up to its diameter in front.
+      glm::vec3 center;
+      float radius;
+      cameras.main->BoundView(cameras.main->nearClip,
+                              shadows.directionalDistance, center, radius);
+      camera->projection = Camera::Projection::Orthographic;
+      camera->transform = Transform::TR(center - data.direction * radius * 3.f,
+                                        light.CachedSceneSpace().rotation);
+      camera->orthoWidth = radius * 2;
+      camera->orthoHeight = radius * 2;
+      camera->nearClip = 0;
+      camera->farClip = radius * 4;
+      break;
+    }
+    default:
+      break;
+  }
+  light.SetLightTransform(camera->GetProjectionMatrix() *
+                          camera->GetViewMatrix());
+}
+
+float dg::Scene::ShadowCoverage(const Light &light) const {
+  Light::ShaderData data = light.GetShaderData();
+  if (data.type == Light::LightType::DIRECTIONAL) {
+    return 1;
+  }
+
+  // Bound the light's shadow by a sphere. A point light's shadow fills the
+  // sphere of its range. Narrow spot light cones are bounded best by the
+  // sphere through the apex and the rim, and wide ones by the rim.
+  float length = std::min(Light::Range(data), LocalShadowFarClip);
+  float angle = std::min(data.outerCutoff, glm::half_pi<float>());
+  glm::vec3 center;
+  float radius;
+  if (data.type == Light::LightType::POINT) {
+    radius = length;
+    center = data.position;
+  } else if (angle < glm::quarter_pi<float>()) {
+    radius = length / (2 * std::cos(angle) * std::cos(angle));
+    center = data.position + data.direction * radius;
+  } else {
+    radius = length * std::sin(angle);
+    center = data.position + data.direction * (length * std::cos(angle));
+  }
+
+  // Fraction of the main camera's view height the sphere spans.
+  const Camera &camera = *cameras.main;
+  float distance =
+      glm::distance(center, camera.CachedSceneSpace().translation);
+  if (distance <= radius) {
+    return 1;
+  }
+  if (camera.projection == Camera::Projection::Orthographic) {
+    return radius * 2 / camera.orthoHeight;
+  }
+  return radius / (distance * std::tan(camera.fov / 2));
 }
 
 void dg::Scene::DrawScene() {
   assert(currentRender.subrender != nullptr);
+  currentRender.subrender->drawCount++;
 
   // Render skybox.
   if (skybox != nullptr && skybox->enabled &&
@@ -430,15 +1130,13 @@ void dg::Scene::DrawScene() {
   }
 
   // Prepare light data.
-  Light::ShaderData lightArray[Light::MAX_LIGHTS];
-  int lightIdx = 0;
+  FrameVector<Light::ShaderData> lightData(frameArena);
   if (currentRender.subrender->sendLights) {
+    lightData.reserve(currentRender.lights.size());
     for (auto &light : currentRender.lights) {
-      if (lightIdx >= Light::MAX_LIGHTS) {
-        break;
-      }
-      lightArray[lightIdx++] = (*light).GetShaderData();
+      lightData.push_back(light->GetShaderData());
     }
+    lightClusters.Build(lightData, view, projection);
   }
 
   // Gather non-persistent data we'll send to each model's shader once per draw.
@@ -449,48 +1147,242 @@ void dg::Scene::DrawScene() {
   context.projection = projection;
   context.cameraPos = &cameraPos;
   if (currentRender.subrender->sendLights) {
-    context.lights = &lightArray;
-    if (currentRender.shadowCastingLight != nullptr) {
-      auto texture = currentRender.shadowCastingLight->GetShadowMap();
-      if (texture != nullptr) {
-        context.shadowMap = texture;
+    context.lightClusters = &lightClusters;
+    if (currentRender.shadowMap != nullptr) {
+      context.shadowMap = currentRender.shadowMap;
+    }
+    context.shadowCascades = currentRender.shadowCascades;
+    context.shadowCubes = &currentRender.shadowCubes;
+  }
+
+  // Record what to draw, unless the previous subrender already recorded the
+  // same thing, as is the case for the second VR eye.
+  const Subrender &subrender = *currentRender.subrender;
+  if (!CanReuseDrawCommands(subrender)) {
+    RecordDrawCommands(subrender);
+  }
+  const auto &commands = currentRender.drawCommands;
+
+  // Build the model-view-projection matrices in parallel, so that drawing
+  // only has to submit them.
+  glm::mat4x4 viewProjection = projection * view;
+  FrameVector<glm::mat4x4> matricesMVP(commands.size(), frameArena);
+  JobSystem::ParallelFor(
+      commands.size(), 256, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+          matricesMVP[i] =
+              viewProjection * commands[i].model->CachedSceneSpaceMatrix();
+        }
+      });
+
+  // Choose each model's most significant lights, for shaders that read
+  // the fixed-size _Lights array rather than the clusters.
+  FrameVector<LightSelection> lightSelections(frameArena);
+  if (currentRender.subrender->sendLights) {
+    lightSelections.resize(commands.size());
+    FrameVector<float> lightRanges(lightData.size(), frameArena);
+    for (size_t i = 0; i < lightData.size(); i++) {
+      lightRanges[i] = Light::Range(lightData[i]);
+    }
+    JobSystem::ParallelFor(
+        commands.size(), 256, [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++) {
+            SelectLights(*commands[i].model, lightData, lightRanges,
+                         lightSelections[i]);
+          }
+        });
+  }
+
+  // Render models. Material state is only set up again when the material
+  // changes between consecutive commands, and lights only when the
+  // selection changes.
+  Material *boundMaterial = nullptr;
+  bool sendLightArray = false;
+  const LightSelection *sentSelection = nullptr;
+  Light::ShaderData lightArray[Light::MAX_LIGHTS];
+  for (size_t i = 0; i < commands.size(); i++) {
+    const DrawCommand &command = commands[i];
+    if (command.material != boundMaterial) {
+      if (boundMaterial != nullptr) {
+        Model::EndMaterial(boundMaterial);
+      }
+      Model::BeginMaterial(context, command.material);
+      boundMaterial = command.material;
+      sendLightArray =
+          !lightSelections.empty() && command.material->UsesLightArray();
+      sentSelection = nullptr;
+    }
+
+    if (sendLightArray &&
+        (sentSelection == nullptr || *sentSelection != lightSelections[i])) {
+      const LightSelection &selection = lightSelections[i];
+      for (int j = 0; j < Light::MAX_LIGHTS; j++) {
+        lightArray[j] = (j < selection.count)
+                            ? lightData[selection.indices[j]]
+                            : Light::ShaderData();
+      }
+      command.material->SendLights(lightArray);
+      sentSelection = &selection;
+    }
+
+    context.matrixMVP = &matricesMVP[i];
+    command.model->DrawWithMaterial(context, command.material);
+  }
+  if (boundMaterial != nullptr) {
+    Model::EndMaterial(boundMaterial);
+  }
+
+  // Each drawn model resolves at most one cached shader replacement, so if
+  // the cache has grown larger than that, it's holding on to materials that
+  // are no longer drawn. Evict them so they can be released.
+  auto &replacementCache = currentRender.subrender->shaderReplacementCache;
+  if (replacementCache.size() > currentRender.models.size()) {
+    unsigned int drawCount = currentRender.subrender->drawCount;
+    for (auto it = replacementCache.begin(); it != replacementCache.end();) {
+      if (it->second.lastUsedDraw != drawCount) {
+        it = replacementCache.erase(it);
+      } else {
+        it++;
       }
     }
   }
+}
+
+void dg::Scene::SelectLights(const Model &model,
+                             const FrameVector<Light::ShaderData> &lights,
+                             const FrameVector<float> &ranges,
+                             LightSelection &selection) {
+  glm::vec4 bounds = SceneSpaceBounds(model);
+  glm::vec3 center = glm::vec3(bounds);
+  float radius = bounds.w;
 
-  // Render models.
-  for (auto &currentModel : currentRender.models) {
-    // If the subrender's layer bitmask excludes this model's layer, skip
-    // drawing it.
-    if (!(currentModel.model->layer & currentRender.subrender->layerMask)) {
+  // Rank lights by how bright they are at the nearest point of the bounds,
+  // keeping the top MAX_LIGHTS in order. Lights out of range of the bounds
+  // don't reach the model at all.
+  float scores[Light::MAX_LIGHTS];
+  selection.count = 0;
+  size_t count = std::min(lights.size(), (size_t)UINT16_MAX);
+  for (size_t i = 0; i < count; i++) {
+    const Light::ShaderData &light = lights[i];
+    if (light.type == Light::LightType::NONE) {
       continue;
     }
+    float distance = 0;
+    if (light.type != Light::LightType::DIRECTIONAL) {
+      distance =
+          std::max(glm::distance(light.position, center) - radius, 0.0f);
+      if (distance >= ranges[i]) {
+        continue;
+      }
+    }
+    float score =
+        Light::Brightness(light) * Light::Attenuation(light, distance);
 
-    // Use either the model's assigned material or the subrender's material
-    // override if not null.
-    std::shared_ptr<Material> sharedMaterial;
-    if (currentRender.subrender->material == nullptr) {
-      sharedMaterial = (*currentModel.model).material;
-    } else {
-      sharedMaterial = currentRender.subrender->material;
+    int slot = selection.count;
+    while (slot > 0 && scores[slot - 1] < score) {
+      slot--;
+    }
+    if (slot == Light::MAX_LIGHTS) {
+      continue;
+    }
+    for (int j = std::min(selection.count, Light::MAX_LIGHTS - 1); j > slot;
+         j--) {
+      scores[j] = scores[j - 1];
+      selection.indices[j] = selection.indices[j - 1];
+    }
+    scores[slot] = score;
+    selection.indices[slot] = (uint16_t)i;
+    selection.count = std::min(selection.count + 1, Light::MAX_LIGHTS);
+  }
+}
+
+void dg::Scene::RecordDrawCommands(const Subrender &subrender) {
+  const auto &models = currentRender.models;
+  auto &commands = currentRender.drawCommands;
+  commands = FrameVector<DrawCommand>(models.size(), frameArena);
+
+  // Layer tests and material overrides don't touch shared state, so they
+  // can be evaluated in parallel. Culled models get a null material.
+  JobSystem::ParallelFor(
+      models.size(), 1024, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+          DrawCommand &command = commands[i];
+          command.modelIndex = (uint32_t)i;
+          command.model = models[i].model;
+          if (!(command.model->layer & subrender.layerMask) ||
+              (subrender.modelFilter == Subrender::ModelFilter::Static &&
+               !command.model->isStatic) ||
+              (subrender.modelFilter == Subrender::ModelFilter::Dynamic &&
+               command.model->isStatic)) {
+            command.material = nullptr;
+          } else if (subrender.material != nullptr) {
+            command.material = subrender.material.get();
+          } else {
+            command.material = command.model->material.get();
+          }
+        }
+      });
+
+  // Compact the visible commands. Resolving shader replacements updates the
+  // subrender's cache, so that's done here, serially.
+  bool replaceShaders = !subrender.shaderReplacements.empty();
+  size_t count = 0;
+  for (size_t i = 0; i < commands.size(); i++) {
+    if (commands[i].material == nullptr) {
+      continue;
     }
-    Material *material = sharedMaterial.get();
+    if (replaceShaders) {
+      commands[i].material = subrender.ResolveMaterial(
+          (subrender.material == nullptr) ? commands[i].model->material
+                                          : subrender.material);
+    }
+    commands[count++] = commands[i];
+  }
+  commands.resize(count);
+
+  // Commands with shader replacements are never reused, since that would
+  // require comparing the replacement maps.
+  currentRender.hasDrawCommands = !replaceShaders;
+  currentRender.drawCommandsLayerMask = subrender.layerMask;
+  currentRender.drawCommandsModelFilter = subrender.modelFilter;
+  currentRender.drawCommandsMaterial = subrender.material.get();
+}
 
-    // Check to see if this subrender intends to replace the chosen material's
-    // shader with another shader.
-    auto shaderReplacement = currentRender.subrender->shaderReplacements.find(
-        sharedMaterial->shader.get());
-    ShaderReplacedMaterial shaderReplacedMaterial;
-    if (shaderReplacement !=
-        currentRender.subrender->shaderReplacements.end()) {
-      shaderReplacedMaterial =
-          ShaderReplacedMaterial(sharedMaterial, shaderReplacement->second);
-      material = &shaderReplacedMaterial;
+bool dg::Scene::CanReuseDrawCommands(const Subrender &subrender) const {
+  return currentRender.hasDrawCommands &&
+         subrender.shaderReplacements.empty() &&
+         subrender.layerMask == currentRender.drawCommandsLayerMask &&
+         subrender.modelFilter == currentRender.drawCommandsModelFilter &&
+         subrender.material.get() == currentRender.drawCommandsMaterial;
+}
+
+dg::Material *dg::Scene::Subrender::ResolveMaterial(
+    const std::shared_ptr<Material> &material) const {
+  if (shaderReplacements.empty()) {
+    return material.get();
+  }
+
+  ShaderReplacement &entry = shaderReplacementCache[material.get()];
+  entry.lastUsedDraw = drawCount;
+
+  // The replacement only depends on the source material's shader, so only
+  // resolve it again if that has changed since the entry was cached.
+  Shader *sourceShader = material->shader.get();
+  if (entry.sourceShader != sourceShader) {
+    entry.sourceShader = sourceShader;
+    auto shaderReplacement = shaderReplacements.find(sourceShader);
+    if (shaderReplacement != shaderReplacements.end()) {
+      entry.material = std::make_shared<ShaderReplacedMaterial>(
+          material, shaderReplacement->second);
+    } else {
+      entry.material = nullptr;
     }
+  }
 
-    // Draw the model with the context and material.
-    (*currentModel.model).Draw(context, material);
+  if (entry.material != nullptr) {
+    return entry.material.get();
   }
+  return material.get();
 }
 
 bool dg::Scene::AutomaticWindowTitle() const {
@@ -3,6 +3,9 @@
 //
 
 #include "dg/SceneObject.h"
+#include <algorithm>
+#include <cassert>
+#include "dg/SceneSpaceCache.h"
 
 #include <glm/gtc/matrix_transform.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
@@ -11,7 +14,8 @@
 
 dg::SceneObject::SceneObject(Transform transform) : transform(transform) {}
 
-void dg::SceneObject::AddBehavior(std::shared_ptr<Behavior> behavior) {
+void dg::SceneObject::AddBehavior(std::shared_ptr<Behavior> behavior,
+                                  Behavior::TypeID type) {
   if (behavior->GetSceneObject().get() != this) {
     throw std::runtime_error(
         "Do not call SceneObject::AddBehavior() to attach a behavior. "
@@ -19,15 +23,16 @@ void dg::SceneObject::AddBehavior(std::shared_ptr<Behavior> behavior) {
   }
 
   behaviors.push_back(behavior);
+  behaviorTypes.push_back(type);
 }
 
 void dg::SceneObject::UpdateBehaviors() {
-  // Execute Update() for all behaviors.
+  // Execute Update() for all main-thread behaviors.
   for (
       auto behavior = behaviors.begin();
       behavior != behaviors.end();
       behavior++) {
-    if ((*behavior)->enabled) {
+    if ((*behavior)->enabled && !(*behavior)->GetUpdateAccess().parallel) {
       (*behavior)->Update();
     }
   }
@@ -46,33 +51,65 @@ dg::Transform dg::SceneObject::SceneSpace() const {
     return transform;
   }
 
-  return parent->SceneSpace() * transform;
+  return ParentSceneSpace() * transform;
 }
 
 void dg::SceneObject::SetSceneSpace(Transform transform) {
   if (parent == nullptr) {
     this->transform = transform;
   } else {
-    this->transform = parent->SceneSpace().Inverse() * transform;
+    this->transform = ParentSceneSpace().Inverse() * transform;
   }
 }
 
+dg::Transform dg::SceneObject::ParentSceneSpace() const {
+  assert(parent != nullptr);
+
+  // A parent in a SceneSpaceCache already knows its scene space, so only
+  // objects outside of one need to recurse towards the root.
+  if (parent->sceneSpaceCache != nullptr) {
+    return parent->CachedSceneSpace();
+  }
+  return parent->SceneSpace();
+}
+
 void dg::SceneObject::CacheSceneSpace() {
   if (parent == nullptr) {
     xfCachedSceneSpace = transform;
   } else {
-    xfCachedSceneSpace = parent->xfCachedSceneSpace * transform;
+    xfCachedSceneSpace = parent->CachedSceneSpace() * transform;
   }
+  matCachedSceneSpace = xfCachedSceneSpace.ToMat4();
+  matCachedNormal = glm::transpose(glm::inverse(matCachedSceneSpace));
 
   for (auto &child : children) {
-    child->CacheSceneSpace();
+    if (child != nullptr) {
+      child->CacheSceneSpace();
+    }
   }
 }
 
-dg::Transform dg::SceneObject::CachedSceneSpace() const {
+const dg::Transform &dg::SceneObject::CachedSceneSpace() const {
+  if (sceneSpaceCache != nullptr) {
+    return sceneSpaceCache->SceneSpace(sceneSpaceSlot);
+  }
   return xfCachedSceneSpace;
 }
 
+const glm::mat4x4 &dg::SceneObject::CachedSceneSpaceMatrix() const {
+  if (sceneSpaceCache != nullptr) {
+    return sceneSpaceCache->SceneSpaceMatrix(sceneSpaceSlot);
+  }
+  return matCachedSceneSpace;
+}
+
+const glm::mat4x4 &dg::SceneObject::CachedNormalMatrix() const {
+  if (sceneSpaceCache != nullptr) {
+    return sceneSpaceCache->NormalMatrix(sceneSpaceSlot);
+  }
+  return matCachedNormal;
+}
+
 void dg::SceneObject::AddChild(std::shared_ptr<SceneObject> child) {
   AddChild(child, true);
 }
@@ -81,15 +118,25 @@ void dg::SceneObject::AddChild(
     std::shared_ptr<SceneObject> child, bool preserveSceneSpace) {
   if (child->parent == this) return;
   if (child->parent != nullptr) {
-    child->parent->children.erase(child);
+    child->parent->EraseChild(child->childIndex);
+  }
+  if (child->sceneSpaceCache != nullptr) {
+    child->sceneSpaceCache->Detach(*child);
   }
-  children.insert(child);
+  child->childIndex = (int)children.size();
+  children.push_back(child);
   child->SetParent(this, preserveSceneSpace);
+  if (sceneSpaceCache != nullptr) {
+    sceneSpaceCache->MarkStale();
+  }
 }
 
 void dg::SceneObject::RemoveChild(std::shared_ptr<SceneObject> child) {
   if (child->parent != this) return;
-  children.erase(child);
+  if (child->sceneSpaceCache != nullptr) {
+    child->sceneSpaceCache->Detach(*child);
+  }
+  EraseChild(child->childIndex);
   child->SetParent(nullptr, true);
 }
 
@@ -97,7 +144,8 @@ dg::SceneObject *dg::SceneObject::Parent() const {
   return parent;
 }
 
-std::set<std::shared_ptr<dg::SceneObject>> &dg::SceneObject::Children() {
+const std::vector<std::shared_ptr<dg::SceneObject>> &
+dg::SceneObject::Children() const {
   return children;
 }
 
@@ -174,3 +222,22 @@ void dg::SceneObject::SetParent(
     this->parent = parent;
   }
 }
+
+// Removes the child at index in O(1) by leaving a null in its place, so the
+// others keep their order and indices. Once nulls make up half of the
+// children, they're compacted away, which keeps removal O(1) amortized.
+void dg::SceneObject::EraseChild(int index) {
+  children[index]->childIndex = -1;
+  children[index] = nullptr;
+  removedChildren++;
+  if (removedChildren * 2 < (int)children.size()) {
+    return;
+  }
+
+  children.erase(std::remove(children.begin(), children.end(), nullptr),
+                 children.end());
+  for (int i = 0; i < (int)children.size(); i++) {
+    children[i]->childIndex = i;
+  }
+  removedChildren = 0;
+}
@@ -0,0 +1,232 @@
+//
+//  SceneSpaceCache.cpp
+//
+
+#include "dg/SceneSpaceCache.h"
+#include <algorithm>
+#include <cassert>
+#include "dg/JobSystem.h"
+#include "dg/SceneObject.h"
+
+dg::SceneSpaceCache::~SceneSpaceCache() {
+  Clear();
+}
+
+void dg::SceneSpaceCache::Clear() {
+  for (int slot = 0; slot < (int)objects.size(); slot++) {
+    if (objects[slot] != nullptr) {
+      Release(slot);
+    }
+  }
+  objects.clear();
+  parents.clear();
+  serialSlots.clear();
+  parallelRanges.clear();
+}
+
+void dg::SceneSpaceCache::Release(int slot) {
+  SceneObject *object = objects[slot];
+  object->xfCachedSceneSpace = sceneSpaces[slot];
+  object->matCachedSceneSpace = matrices[slot];
+  object->matCachedNormal = normalMatrices[slot];
+  object->sceneSpaceCache = nullptr;
+  object->sceneSpaceSlot = -1;
+  objects[slot] = nullptr;
+}
+
+void dg::SceneSpaceCache::Rebuild(SceneObject &root) {
+  assert(!structureLocked);
+  Clear();
+
+  std::vector<std::pair<SceneObject *, int>> remaining;
+  remaining.emplace_back(&root, -1);
+  while (!remaining.empty()) {
+    SceneObject *object = remaining.back().first;
+    int parent = remaining.back().second;
+    remaining.pop_back();
+
+    int slot = (int)objects.size();
+    objects.push_back(object);
+    parents.push_back(parent);
+    object->sceneSpaceCache = this;
+    object->sceneSpaceSlot = slot;
+
+    // Push in reverse so that children are visited in order.
+    auto &children = object->Children();
+    for (auto child = children.rbegin(); child != children.rend(); child++) {
+      if (*child != nullptr) {
+        remaining.emplace_back(child->get(), slot);
+      }
+    }
+  }
+
+  size_t count = objects.size();
+  localTransforms.resize(count);
+  sceneSpaces.resize(count);
+  matrices.resize(count);
+  normalMatrices.resize(count);
+  changed.resize(count);
+  active.resize(count);
+
+  // Start from each object's last cached values so that they're valid until
+  // the next update.
+  for (size_t slot = 0; slot < count; slot++) {
+    sceneSpaces[slot] = objects[slot]->xfCachedSceneSpace;
+    matrices[slot] = objects[slot]->matCachedSceneSpace;
+    normalMatrices[slot] = objects[slot]->matCachedNormal;
+  }
+
+  // Split the hierarchy into contiguous subtree ranges that can be updated
+  // in parallel. ends[slot] is one past the last slot in slot's subtree.
+  std::vector<int> ends(count);
+  for (int slot = (int)count - 1; slot >= 0; slot--) {
+    ends[slot] = std::max(ends[slot], slot + 1);
+    if (parents[slot] >= 0) {
+      ends[parents[slot]] = std::max(ends[parents[slot]], ends[slot]);
+    }
+  }
+  serialSlots.clear();
+  parallelRanges.clear();
+  if (count > 0) {
+    PartitionSubtree(0, ends);
+  }
+
+  // Snapshots of the previous structure no longer line up with the slots,
+  // so read the arrays until a new one is acquired.
+  ReadFromArrays();
+  rebuildCount++;
+
+  stale = false;
+  recomputeAll = true;
+}
+
+void dg::SceneSpaceCache::ReadFromArrays() {
+  read.sceneSpaces = sceneSpaces.data();
+  read.matrices = matrices.data();
+  read.normalMatrices = normalMatrices.data();
+  read.active = active.data();
+}
+
+void dg::SceneSpaceCache::SetPipelined(bool pipelined) {
+  this->pipelined = pipelined;
+  if (!pipelined) {
+    ReadFromArrays();
+  }
+}
+
+void dg::SceneSpaceCache::Publish() {
+  assert(pipelined);
+  Snapshot &snapshot = snapshots.WriteBuffer();
+  snapshot.rebuild = rebuildCount;
+  snapshot.sceneSpaces = sceneSpaces;
+  snapshot.matrices = matrices;
+  snapshot.normalMatrices = normalMatrices;
+  snapshot.active = active;
+  snapshots.Publish();
+}
+
+bool dg::SceneSpaceCache::Acquire() {
+  assert(pipelined);
+  if (!snapshots.Acquire()) {
+    return false;
+  }
+  const Snapshot &snapshot = snapshots.ReadBuffer();
+  if (snapshot.rebuild != rebuildCount) {
+    // Published before the last rebuild.
+    ReadFromArrays();
+    return false;
+  }
+  read.sceneSpaces = snapshot.sceneSpaces.data();
+  read.matrices = snapshot.matrices.data();
+  read.normalMatrices = snapshot.normalMatrices.data();
+  read.active = snapshot.active.data();
+  return true;
+}
+
+void dg::SceneSpaceCache::Update() {
+  assert(!stale);
+
+  // Ancestors of the parallel ranges first, in hierarchy order, so that
+  // every range's parents are up to date before it starts.
+  for (int slot : serialSlots) {
+    UpdateSlot(slot);
+  }
+
+  JobSystem::ParallelFor(
+      parallelRanges.size(), 1, [this](size_t begin, size_t end) {
+        for (size_t range = begin; range < end; range++) {
+          for (int slot = parallelRanges[range].first;
+               slot < parallelRanges[range].second; slot++) {
+            UpdateSlot(slot);
+          }
+        }
+      });
+
+  recomputeAll = false;
+}
+
+void dg::SceneSpaceCache::UpdateSlot(int slot) {
+  const SceneObject *object = objects[slot];
+  int parent = parents[slot];
+
+  // The root is always active, since it's the one being rendered.
+  active[slot] = (parent < 0) || (object->enabled && active[parent]);
+
+  bool parentChanged = (parent >= 0 && changed[parent]);
+  if (!recomputeAll && !parentChanged &&
+      object->transform == localTransforms[slot]) {
+    changed[slot] = false;
+    return;
+  }
+
+  localTransforms[slot] = object->transform;
+  if (parent < 0) {
+    sceneSpaces[slot] = object->transform;
+  } else {
+    sceneSpaces[slot] = sceneSpaces[parent] * object->transform;
+  }
+  matrices[slot] = sceneSpaces[slot].ToMat4();
+  normalMatrices[slot] = glm::transpose(glm::inverse(matrices[slot]));
+  changed[slot] = true;
+}
+
+void dg::SceneSpaceCache::PartitionSubtree(int slot,
+                                           const std::vector<int> &ends) {
+  if (ends[slot] - slot <= SlotsPerJob) {
+    // Merge with the previous range if they're adjacent and still small.
+    if (!parallelRanges.empty() && parallelRanges.back().second == slot &&
+        ends[slot] - parallelRanges.back().first <= SlotsPerJob) {
+      parallelRanges.back().second = ends[slot];
+    } else {
+      parallelRanges.emplace_back(slot, ends[slot]);
+    }
+    return;
+  }
+
+  // Too large for one job, so update this object serially and split up its
+  // children's subtrees.
+  serialSlots.push_back(slot);
+  for (int child = slot + 1; child < ends[slot]; child = ends[child]) {
+    PartitionSubtree(child, ends);
+  }
+}
+
+void dg::SceneSpaceCache::Detach(SceneObject &object) {
+  assert(!structureLocked);
+  stale = true;
+
+  std::vector<SceneObject *> remaining;
+  remaining.push_back(&object);
+  while (!remaining.empty()) {
+    SceneObject *current = remaining.back();
+    remaining.pop_back();
+    if (current->sceneSpaceCache == this) {
+      Release(current->sceneSpaceSlot);
+    }
+    for (auto &child : current->Children()) {
+      if (child != nullptr) {
+        remaining.push_back(child.get());
+      }
+    }
+  }
+}
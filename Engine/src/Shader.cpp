@@ -8,9 +8,16 @@
 #include <memory>
 #include "dg/Exceptions.h"
 #include "dg/FileUtils.h"
+#include "dg/JobSystem.h"
 #include "dg/Utils.h"
 
-#if defined(_DIRECTX)
+#if defined(_OPENGL)
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include "dg/opengl/ProgramBinaryCache.h"
+#elif defined(_DIRECTX)
 // For the DirectX Math library
 using namespace DirectX;
 #endif
@@ -39,17 +46,41 @@ std::shared_ptr<dg::Shader> dg::Shader::FromFiles(
 #endif
 }
 
+std::shared_ptr<dg::Shader> dg::Shader::FromFiles(
+    const std::string &vertexPath, const std::string &fragmentPath,
+    const std::vector<std::string> &defines) {
+#if defined(_OPENGL)
+  return std::static_pointer_cast<Shader>(
+    OpenGLShader::FromFiles(vertexPath, fragmentPath, defines));
+#elif defined(_DIRECTX)
+  throw EngineError("TODO: Implement support for DirectX shader defines.");
+#endif
+}
+
+void dg::Shader::CompilePending() {
+#if defined(_OPENGL)
+  OpenGLShader::CompilePending();
+#endif
+}
+
 #pragma endregion
 
 #if defined(_OPENGL)
 #pragma region OpenGL Shader
 
+#define DG_GL_COMPLETION_STATUS 0x91B1
+
+std::vector<std::weak_ptr<dg::OpenGLShader>>
+    dg::OpenGLShader::uncompiledShaders;
+bool dg::OpenGLShader::parallelCompileInitialized = false;
+bool dg::OpenGLShader::parallelCompileSupported = false;
+
 std::shared_ptr<dg::OpenGLShader> dg::OpenGLShader::FromFiles(
     const std::string& vertexPath, const std::string& fragmentPath) {
   auto shader = std::make_shared<OpenGLShader>();
   shader->vertexPath = vertexPath;
   shader->fragmentPath = fragmentPath;
-  shader->CreateProgram();
+  uncompiledShaders.push_back(shader);
   return shader;
 }
 
@@ -60,7 +91,18 @@ std::shared_ptr<dg::OpenGLShader> dg::OpenGLShader::FromFiles(
   shader->vertexPath = vertexPath;
   shader->geometryPath = geometryPath;
   shader->fragmentPath = fragmentPath;
-  shader->CreateProgram();
+  uncompiledShaders.push_back(shader);
+  return shader;
+}
+
+std::shared_ptr<dg::OpenGLShader> dg::OpenGLShader::FromFiles(
+    const std::string &vertexPath, const std::string &fragmentPath,
+    const std::vector<std::string> &defines) {
+  auto shader = std::make_shared<OpenGLShader>();
+  shader->vertexPath = vertexPath;
+  shader->fragmentPath = fragmentPath;
+  shader->defines = defines;
+  uncompiledShaders.push_back(shader);
   return shader;
 }
 
@@ -71,24 +113,174 @@ dg::OpenGLShader::~OpenGLShader() {
   }
 }
 
-void dg::OpenGLShader::CreateProgram() {
-  assert(programHandle == 0);
+void dg::OpenGLShader::CompilePending() {
+  std::vector<std::shared_ptr<OpenGLShader>> shaders;
+  for (auto &weakShader : uncompiledShaders) {
+    auto shader = weakShader.lock();
+    if (shader != nullptr && shader->programHandle == 0) {
+      shaders.push_back(shader);
+    }
+  }
+  uncompiledShaders.clear();
+  if (shaders.empty()) {
+    return;
+  }
+
+  InitializeParallelCompile();
+
+  // Preprocessing doesn't touch GL, so it can run on worker threads.
+  JobSystem::ParallelFor(shaders.size(), 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      shaders[i]->PreprocessSources();
+    }
+  });
 
-  std::vector<std::shared_ptr<ShaderSource>> sources;
-  sources.push_back(dg::ShaderSource::FromFile(GL_VERTEX_SHADER, vertexPath));
+  // Issue every compile and link before checking any of them. Querying a
+  // shader's status forces the driver to finish compiling it.
+  auto lastCompletion = std::chrono::high_resolution_clock::now();
+  for (auto &shader : shaders) {
+    shader->BeginCreateProgram();
+  }
+
+  while (!shaders.empty()) {
+    bool finishedAny = false;
+    for (auto iter = shaders.begin(); iter != shaders.end();) {
+      if ((*iter)->IsProgramComplete()) {
+        // Programs compiling in parallel overlap, so each is charged only
+        // the time since the previous one completed, and their times add
+        // up to the batch's.
+        auto now = std::chrono::high_resolution_clock::now();
+        if (parallelCompileSupported) {
+          std::chrono::duration<double> sinceLast = now - lastCompletion;
+          (*iter)->compileSeconds = sinceLast.count();
+        }
+        (*iter)->FinishCreateProgram();
+        lastCompletion = std::chrono::high_resolution_clock::now();
+        iter = shaders.erase(iter);
+        finishedAny = true;
+      } else {
+        iter++;
+      }
+    }
+    if (!finishedAny) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void dg::OpenGLShader::InitializeParallelCompile() {
+  if (parallelCompileInitialized) {
+    return;
+  }
+  parallelCompileInitialized = true;
+
+  typedef void(APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+  MaxShaderCompilerThreadsProc maxShaderCompilerThreads = nullptr;
+  if (glfwExtensionSupported("GL_KHR_parallel_shader_compile")) {
+    maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress(
+        "glMaxShaderCompilerThreadsKHR");
+  } else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile")) {
+    maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress(
+        "glMaxShaderCompilerThreadsARB");
+  }
+
+  if (maxShaderCompilerThreads != nullptr) {
+    // Let the driver choose how many threads to use.
+    maxShaderCompilerThreads(0xFFFFFFFF);
+    parallelCompileSupported = true;
+  }
+}
+
+void dg::OpenGLShader::PreprocessSources() {
+  if (!sources.empty()) {
+    return;
+  }
+
+  sources.push_back(
+      dg::ShaderSource::Preprocess(GL_VERTEX_SHADER, vertexPath, defines));
   if (!geometryPath.empty()) {
-    sources.push_back(
-        dg::ShaderSource::FromFile(GL_GEOMETRY_SHADER, geometryPath));
+    sources.push_back(dg::ShaderSource::Preprocess(GL_GEOMETRY_SHADER,
+                                                   geometryPath, defines));
   }
   sources.push_back(
-      dg::ShaderSource::FromFile(GL_FRAGMENT_SHADER, fragmentPath));
+      dg::ShaderSource::Preprocess(GL_FRAGMENT_SHADER, fragmentPath, defines));
+}
+
+void dg::OpenGLShader::CreateProgram() {
+  BeginCreateProgram();
+  FinishCreateProgram();
+}
+
+void dg::OpenGLShader::BeginCreateProgram() {
+  assert(programHandle == 0);
+
+  PreprocessSources();
+
+  cacheKey = ProgramBinaryCache::KeyForSources(sources);
+  programHandle = ProgramBinaryCache::Load(cacheKey);
+  if (programHandle != 0) {
+    sources.clear();
+    CacheUniformLocations();
+    return;
+  }
+
+  // Time only the calls made for this program, since others may be issued
+  // before it's finished.
+  auto startTime = std::chrono::high_resolution_clock::now();
+  for (auto &source : sources) {
+    source->BeginCompile();
+  }
 
   programHandle = glCreateProgram();
+  ProgramBinaryCache::PrepareProgram(programHandle);
   for (auto &source : sources) {
     glAttachShader(programHandle, source->GetHandle());
   }
   glLinkProgram(programHandle);
-  CheckLinkErrors();
+  programPending = true;
+  std::chrono::duration<double> issueTime =
+      std::chrono::high_resolution_clock::now() - startTime;
+  compileSeconds = issueTime.count();
+}
+
+void dg::OpenGLShader::FinishCreateProgram() {
+  if (!programPending) {
+    return;
+  }
+  programPending = false;
+
+  // Checking for errors waits for anything the driver hasn't finished.
+  auto startTime = std::chrono::high_resolution_clock::now();
+  try {
+    for (auto &source : sources) {
+      source->CheckCompileErrors();
+    }
+    CheckLinkErrors();
+  } catch (...) {
+    // Don't leave a broken program to be bound. The next Use() compiles it
+    // again, and throws again if it's still broken.
+    glDeleteProgram(programHandle);
+    programHandle = 0;
+    sources.clear();
+    throw;
+  }
+
+  std::chrono::duration<double> finishTime =
+      std::chrono::high_resolution_clock::now() - startTime;
+  compileSeconds += finishTime.count();
+  ProgramBinaryCache::Store(cacheKey, programHandle, compileSeconds);
+  sources.clear();
+  CacheUniformLocations();
+}
+
+bool dg::OpenGLShader::IsProgramComplete() const {
+  if (!programPending || !parallelCompileSupported) {
+    return true;
+  }
+
+  GLint complete = GL_FALSE;
+  glGetProgramiv(programHandle, DG_GL_COMPLETION_STATUS, &complete);
+  return complete == GL_TRUE;
 }
 
 void dg::OpenGLShader::CheckLinkErrors() {
@@ -101,12 +293,61 @@ void dg::OpenGLShader::CheckLinkErrors() {
   }
 }
 
+void dg::OpenGLShader::CacheUniformLocations() {
+  uniformLocations.clear();
+
+  GLint uniformCount = 0;
+  GLint maxNameLength = 0;
+  glGetProgramiv(programHandle, GL_ACTIVE_UNIFORMS, &uniformCount);
+  glGetProgramiv(programHandle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+  std::vector<GLchar> nameBuffer(std::max(maxNameLength, 1));
+  for (GLint i = 0; i < uniformCount; i++) {
+    GLint size;
+    GLenum type;
+    glGetActiveUniform(programHandle, (GLuint)i, (GLsizei)nameBuffer.size(),
+                       nullptr, &size, &type, nameBuffer.data());
+    std::string name(nameBuffer.data());
+    GLint location = glGetUniformLocation(programHandle, name.c_str());
+    if (location == -1) {
+      // Members of uniform blocks don't have locations.
+      continue;
+    }
+    uniformLocations[name] = location;
+
+    // Arrays are reported once, as "name[0]", but each element can be
+    // looked up on its own.
+    const std::string firstElement = "[0]";
+    if (name.size() > firstElement.size() &&
+        name.compare(name.size() - firstElement.size(), firstElement.size(),
+                     firstElement) == 0) {
+      std::string baseName = name.substr(0, name.size() - firstElement.size());
+      uniformLocations[baseName] = location;
+      for (GLint element = 1; element < size; element++) {
+        std::string elementName =
+            baseName + "[" + std::to_string(element) + "]";
+        uniformLocations[elementName] =
+            glGetUniformLocation(programHandle, elementName.c_str());
+      }
+    }
+  }
+}
+
 void dg::OpenGLShader::Use() {
+  if (programHandle == 0) {
+    CreateProgram();
+  } else if (programPending) {
+    FinishCreateProgram();
+  }
   glUseProgram(programHandle);
 }
 
+bool dg::OpenGLShader::HasUniform(const std::string& name) {
+  return GetUniformLocation(name) != -1;
+}
+
 GLint dg::OpenGLShader::GetUniformLocation(const std::string& name) const {
-  return glGetUniformLocation(programHandle, name.c_str());
+  auto iter = uniformLocations.find(name);
+  return iter != uniformLocations.end() ? iter->second : -1;
 }
 
 GLint dg::OpenGLShader::GetAttributeLocation(const std::string& name) const {
@@ -197,6 +438,11 @@ void dg::DirectXShader::Use() {
   pixelShader->CopyAllBufferData();
 }
 
+bool dg::DirectXShader::HasUniform(const std::string& name) {
+  return vertexShader->GetVariableInfo(name) != nullptr ||
+         pixelShader->GetVariableInfo(name) != nullptr;
+}
+
 void dg::DirectXShader::SetBool(const std::string& name, bool value) {
   vertexShader->SetInt(name, value);
   pixelShader->SetInt(name, value);
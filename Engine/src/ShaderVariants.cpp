@@ -0,0 +1,39 @@
+//
+//  ShaderVariants.cpp
+//
+
+#include "dg/ShaderVariants.h"
+#include <cassert>
+
+dg::ShaderVariants::ShaderVariants(const std::string &vertexPath,
+                                   const std::string &fragmentPath,
+                                   const std::vector<std::string> &keywords)
+    : vertexPath(vertexPath), fragmentPath(fragmentPath), keywords(keywords) {
+  assert(keywords.size() <= sizeof(keyword_mask) * 8);
+}
+
+std::shared_ptr<dg::Shader> dg::ShaderVariants::Get(keyword_mask keywords) {
+#if defined(_DIRECTX)
+  keywords = 0;
+#endif
+
+  auto variant = variants.find(keywords);
+  if (variant != variants.end()) {
+    return variant->second;
+  }
+
+#if defined(_OPENGL)
+  std::vector<std::string> defines;
+  for (size_t i = 0; i < this->keywords.size(); i++) {
+    if (keywords & ((keyword_mask)1 << i)) {
+      defines.push_back(this->keywords[i]);
+    }
+  }
+  auto shader = Shader::FromFiles(vertexPath, fragmentPath, defines);
+#elif defined(_DIRECTX)
+  auto shader = Shader::FromFiles(vertexPath, fragmentPath);
+#endif
+
+  variants[keywords] = shader;
+  return shader;
+}
@@ -0,0 +1,73 @@
+//
+//  ShadowAtlas.cpp
+//
+
+#include "dg/ShadowAtlas.h"
+#include <algorithm>
+#include <cassert>
+
+namespace {
+
+  // Gathers the even bits of a Z-order index into the bits of a coordinate.
+  int CompactBits(uint64_t index) {
+    int value = 0;
+    for (int bit = 0; index != 0; bit++, index >>= 2) {
+      value |= (int)(index & 1) << bit;
+    }
+    return value;
+  }
+
+} // namespace
+
+void dg::ShadowAtlas::Reset(int width, int height) {
+  this->width = width;
+  this->height = height;
+  int limit = std::min(width, height);
+  size = 1;
+  while (size * 2 <= limit) {
+    size *= 2;
+  }
+  lastTileSize = size;
+  usedArea = 0;
+}
+
+bool dg::ShadowAtlas::Allocate(int size, Tile &tile) {
+  assert(size > 0 && (size & (size - 1)) == 0);
+  assert(size <= lastTileSize);
+
+  // Every tile so far is at least this large, so the area they cover is a
+  // whole number of tiles of this size.
+  uint64_t area = (uint64_t)size * size;
+  if (usedArea + area > (uint64_t)this->size * this->size) {
+    return false;
+  }
+  uint64_t index = usedArea / area;
+  tile.x = CompactBits(index) * size;
+  tile.y = CompactBits(index >> 1) * size;
+  tile.size = size;
+  usedArea += area;
+  lastTileSize = size;
+  return true;
+}
+
+int dg::ShadowAtlas::GetSize() const {
+  return size;
+}
+
+int dg::ShadowAtlas::GetMaxTileSize() const {
+  return std::max(size / 2, 1);
+}
+
+int dg::ShadowAtlas::TileSizeForCoverage(float coverage) const {
+  int maxSize = GetMaxTileSize();
+  int tileSize = std::min(MinTileSize, maxSize);
+  while (tileSize * 2 <= maxSize && tileSize * 2 <= coverage * maxSize) {
+    tileSize *= 2;
+  }
+  return tileSize;
+}
+
+glm::vec4 dg::ShadowAtlas::GetRect(const Tile &tile) const {
+  return glm::vec4((float)tile.x / width, (float)tile.y / height,
+                   (float)tile.size / width, (float)tile.size / height);
+}
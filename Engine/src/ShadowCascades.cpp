@@ -0,0 +1,89 @@
+//
+//  ShadowCascades.cpp
+//
+
+#include "dg/ShadowCascades.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include "dg/Lights.h"
+
+void dg::ShadowCascades::Fit(const Camera &camera, const Light &light,
+                             int count, float distance, float splitBlend,
+                             int resolution) {
+  assert(count > 0 && count <= MaxCascades);
+  this->count = count;
+
+  float nearDistance = camera.nearClip;
+  float farDistance = std::max(std::min(distance, camera.farClip),
+                               nearDistance);
+  const Transform &lightSpace = light.CachedSceneSpace();
+  glm::vec3 direction = lightSpace.Forward();
+
+  float start = nearDistance;
+  for (int i = 0; i < MaxCascades; i++) {
+    if (i >= count) {
+      splits[i] = farDistance;
+      continue;
+    }
+
+    float t = (float)(i + 1) / count;
+    float even = nearDistance + (farDistance - nearDistance) * t;
+    float logarithmic = even;
+    if (nearDistance > 0) {
+      logarithmic = nearDistance * std::pow(farDistance / nearDistance, t);
+    }
+    float end = glm::mix(even, logarithmic, splitBlend);
+    splits[i] = end;
+
+    // Round the bounds' radius up, so that rounding errors in it can't
+    // change the size of the cascade's texels between frames.
+    glm::vec3 center;
+    float radius;
+    camera.BoundView(start, end, center, radius);
+    radius = std::ceil(radius * 16) / 16;
+
+    // Snap the center to whole texels across the light.
+    float texelSize = radius * 2 / resolution;
+    glm::vec3 lightSpaceCenter = glm::inverse(lightSpace.rotation) * center;
+    lightSpaceCenter.x = std::floor(lightSpaceCenter.x / texelSize) * texelSize;
+    lightSpaceCenter.y = std::floor(lightSpaceCenter.y / texelSize) * texelSize;
+    center = lightSpace.rotation * lightSpaceCenter;
+
+    // Look down on the sphere from far enough back to catch casters up to
+    // its diameter in front of it.
+    lightCamera.projection = Camera::Projection::Orthographic;
+    lightCamera.transform =
+        Transform::TR(center - direction * radius * 3.f, lightSpace.rotation);
+    lightCamera.aspectRatio = 1;
+    lightCamera.orthoWidth = radius * 2;
+    lightCamera.orthoHeight = radius * 2;
+    lightCamera.nearClip = 0;
+    lightCamera.farClip = radius * 4;
+    transforms[i] =
+        lightCamera.GetProjectionMatrix() * lightCamera.GetViewMatrix();
+
+    start = end;
+  }
+}
+
+int dg::ShadowCascades::GetCount() const {
+  return count;
+}
+
+const glm::vec4 &dg::ShadowCascades::GetSplits() const {
+  return splits;
+}
+
+const glm::mat4x4 &dg::ShadowCascades::GetTransform(int cascade) const {
+  assert(cascade >= 0 && cascade < count);
+  return transforms[cascade];
+}
+
+void dg::ShadowCascades::SetShadowMap(std::shared_ptr<Texture> shadowMap) {
+  this->shadowMap = shadowMap;
+}
+
+std::shared_ptr<dg::Texture> dg::ShadowCascades::GetShadowMap() const {
+  return shadowMap;
+}
@@ -3,6 +3,7 @@
 //
 
 #include "dg/Skybox.h"
+#include "dg/Exceptions.h"
 #include "dg/Graphics.h"
 #include "dg/Material.h"
 #include "dg/Mesh.h"
@@ -19,6 +20,8 @@ std::shared_ptr<dg::Skybox> dg::Skybox::Create(
       return std::shared_ptr<Skybox>(new CubeMeshSkybox(texture));
     case TextureType::CUBEMAP:
       return std::shared_ptr<Skybox>(new CubemapSkybox(texture));
+    case TextureType::_2D_ARRAY:
+      throw EngineError("Cannot create a Skybox from a texture array.");
   }
 }
 
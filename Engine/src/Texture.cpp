@@ -205,6 +205,9 @@ void dg::OpenGLTexture::GenerateMips() {
     case TextureType::_2D:
       glGenerateMipmap(GL_TEXTURE_2D);
       break;
+    case TextureType::_2D_ARRAY:
+      glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+      break;
     case TextureType::CUBEMAP:
       GenerateMips(TextureFace::Right);
       GenerateMips(TextureFace::Left);
@@ -262,6 +265,18 @@ void dg::OpenGLTexture::GenerateImage(void *pixels) {
                      pixels);
       }
       break;
+    case TextureType::_2D_ARRAY:
+      glTexImage3D(GL_TEXTURE_2D_ARRAY,
+                   0,                                  // Level of detail
+                   options.GetOpenGLInternalFormat(),  // Internal format
+                   options.width,
+                   options.height,
+                   options.layers,
+                   0,                                  // Border
+                   options.GetOpenGLExternalFormat(),  // External format
+                   options.GetOpenGLType(),            // Type
+                   pixels);
+      break;
   }
 
   if (pixels != nullptr && options.mipmap) {
@@ -342,7 +357,8 @@ void dg::DirectXTexture::GenerateImage(void *pixels) {
   desc.Width = options.width;
   desc.Height = options.height;
   desc.MipLevels = options.mipmap ? 0 : 1;
-  desc.ArraySize = 1;
+  desc.ArraySize =
+      (options.type == TextureType::_2D_ARRAY) ? options.layers : 1;
   desc.Format = internalFormat;
   desc.SampleDesc.Count = 1;
   if (options.cpuReadable) {
@@ -373,8 +389,14 @@ void dg::DirectXTexture::GenerateImage(void *pixels) {
   if (options.shaderReadable) {
     D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc = {};
     SRVDesc.Format = options.GetDirectXShaderFormat();
-    SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-    SRVDesc.Texture2D.MipLevels = -1;
+    if (options.type == TextureType::_2D_ARRAY) {
+      SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+      SRVDesc.Texture2DArray.MipLevels = -1;
+      SRVDesc.Texture2DArray.ArraySize = options.layers;
+    } else {
+      SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+      SRVDesc.Texture2D.MipLevels = -1;
+    }
 
     hr = Graphics::Instance->device->CreateShaderResourceView(texture, &SRVDesc,
       &srv);
@@ -406,6 +428,37 @@ void dg::DirectXTexture::GenerateImage(void *pixels) {
 
 #pragma region TextureOptions
 
+size_t dg::TextureOptions::EstimatedMemorySize() const {
+  size_t bytesPerPixel;
+  switch (format) {
+    case TexturePixelFormat::RGBA:
+      bytesPerPixel = (pixelType == TexturePixelType::BYTE) ? 4 : 16;
+      break;
+    default:
+      bytesPerPixel = 4;
+      break;
+  }
+  size_t size = (size_t)width * height * bytesPerPixel;
+  if (type == TextureType::CUBEMAP) {
+    size *= 6;
+  } else if (type == TextureType::_2D_ARRAY) {
+    size *= layers;
+  }
+  if (mipmap) {
+    size += size / 3;
+  }
+  return size;
+}
+
+bool dg::operator==(const TextureOptions &a, const TextureOptions &b) {
+  return a.type == b.type && a.wrap == b.wrap &&
+         a.interpolation == b.interpolation && a.format == b.format &&
+         a.pixelType == b.pixelType && a.mipmap == b.mipmap &&
+         a.shaderReadable == b.shaderReadable &&
+         a.cpuReadable == b.cpuReadable && a.width == b.width &&
+         a.height == b.height && a.layers == b.layers;
+}
+
 #if defined(_OPENGL)
 
 GLenum dg::TextureOptions::GetOpenGLTarget() const {
@@ -414,6 +467,8 @@ GLenum dg::TextureOptions::GetOpenGLTarget() const {
       return GL_TEXTURE_2D;
     case TextureType::CUBEMAP:
       return GL_TEXTURE_CUBE_MAP;
+    case TextureType::_2D_ARRAY:
+      return GL_TEXTURE_2D_ARRAY;
   }
 }
 
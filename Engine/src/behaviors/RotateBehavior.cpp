@@ -21,3 +21,11 @@ void dg::RotateBehavior::Update() {
   obj->transform.rotation = glm::rotate(
       obj->transform.rotation, speed * (float)Time::Delta, axis);
 }
+
+dg::Behavior::UpdateAccess dg::RotateBehavior::GetUpdateAccess() const {
+  // Only spins its own object.
+  UpdateAccess access;
+  access.parallel = true;
+  access.writesTransform = true;
+  return access;
+}
@@ -5,21 +5,27 @@
 #include "dg/materials/StandardMaterial.h"
 #include "dg/RasterizerState.h"
 
-std::shared_ptr<dg::Shader> dg::StandardMaterial::standardShader = nullptr;
+std::unique_ptr<dg::ShaderVariants> dg::StandardMaterial::shaderVariants =
+    nullptr;
 
-std::shared_ptr<dg::Shader> dg::StandardMaterial::GetStaticShader() {
-  if (standardShader == nullptr) {
+dg::ShaderVariants &dg::StandardMaterial::GetShaderVariants() {
+  if (shaderVariants == nullptr) {
 #if defined(_OPENGL)
-    standardShader = dg::Shader::FromFiles(
-        "assets/shaders/standard.v.glsl",
-        "assets/shaders/standard.f.glsl");
+    shaderVariants = std::unique_ptr<ShaderVariants>(new ShaderVariants(
+        "assets/shaders/standard.v.glsl", "assets/shaders/standard.f.glsl",
+        {"LIT", "DIFFUSE_MAP", "SPECULAR_MAP", "NORMAL_MAP"}));
 #elif defined(_DIRECTX)
-    standardShader = dg::Shader::FromFiles("StandardVertexShader.cso",
-                                           "StandardPixelShader.cso");
+    shaderVariants = std::unique_ptr<ShaderVariants>(
+        new ShaderVariants("StandardVertexShader.cso",
+                           "StandardPixelShader.cso", {}));
 #endif
   }
 
-  return standardShader;
+  return *shaderVariants;
+}
+
+std::shared_ptr<dg::Shader> dg::StandardMaterial::GetStaticShader() {
+  return GetShaderVariants().Get((ShaderVariants::keyword_mask)Keyword::LIT);
 }
 
 dg::StandardMaterial dg::StandardMaterial::WithColor(glm::vec3 color) {
@@ -67,7 +73,7 @@ dg::StandardMaterial dg::StandardMaterial::WithTexture(
 }
 
 dg::StandardMaterial::StandardMaterial() : Material() {
-  shader = GetStaticShader();
+  shader = GetShaderVariants().Get(keywords);
 
   SetUVScale   (glm::vec2(1));
   SetLit       (true);
@@ -78,7 +84,7 @@ dg::StandardMaterial::StandardMaterial() : Material() {
 }
 
 dg::StandardMaterial::StandardMaterial(StandardMaterial& other)
-    : Material(other) {
+    : Material(other), keywords(other.keywords) {
 }
 
 dg::StandardMaterial::StandardMaterial(StandardMaterial&& other) {
@@ -98,6 +104,17 @@ dg::StandardMaterial& dg::StandardMaterial::operator=(StandardMaterial&& other)
 void dg::swap(StandardMaterial& first, StandardMaterial& second) {
   using std::swap;
   swap((Material&)first, (Material&)second);
+  swap(first.keywords, second.keywords);
+}
+
+void dg::StandardMaterial::SetKeyword(Keyword keyword, bool enabled) {
+  auto mask = (ShaderVariants::keyword_mask)keyword;
+  auto newKeywords = enabled ? (keywords | mask) : (keywords & ~mask);
+  if (newKeywords == keywords) {
+    return;
+  }
+  keywords = newKeywords;
+  shader = GetShaderVariants().Get(keywords);
 }
 
 void dg::StandardMaterial::Use() const {
@@ -113,6 +130,7 @@ void dg::StandardMaterial::SetUVScale(glm::vec2 scale) {
 }
 
 void dg::StandardMaterial::SetLit(bool lit) {
+  SetKeyword(Keyword::LIT, lit);
 #if defined(_OPENGL)
   SetProperty("_Material.lit", lit);
 #elif defined(_DIRECTX)
@@ -129,6 +147,7 @@ void dg::StandardMaterial::SetDiffuse(glm::vec3 diffuse) {
 }
 
 void dg::StandardMaterial::SetDiffuse(glm::vec4 diffuse) {
+  SetKeyword(Keyword::DIFFUSE_MAP, false);
 #if defined(_OPENGL)
   SetProperty("_Material.useDiffuseMap", false);
   SetProperty("_Material.diffuse", diffuse);
@@ -139,6 +158,7 @@ void dg::StandardMaterial::SetDiffuse(glm::vec4 diffuse) {
 }
 
 void dg::StandardMaterial::SetDiffuse(std::shared_ptr<Texture> diffuseMap) {
+  SetKeyword(Keyword::DIFFUSE_MAP, diffuseMap != nullptr);
 #if defined(_OPENGL)
   if (diffuseMap == nullptr) {
     SetProperty("_Material.useDiffuseMap", false);
@@ -163,6 +183,7 @@ void dg::StandardMaterial::SetSpecular(float specular) {
 }
 
 void dg::StandardMaterial::SetSpecular(glm::vec3 specular) {
+  SetKeyword(Keyword::SPECULAR_MAP, false);
 #if defined(_OPENGL)
   SetProperty("_Material.useSpecularMap", false);
   SetProperty("_Material.specular", specular);
@@ -175,6 +196,7 @@ void dg::StandardMaterial::SetSpecular(glm::vec3 specular) {
 }
 
 void dg::StandardMaterial::SetSpecular(std::shared_ptr<Texture> specularMap) {
+  SetKeyword(Keyword::SPECULAR_MAP, specularMap != nullptr);
 #if defined(_OPENGL)
   if (specularMap == nullptr) {
     SetProperty("_Material.useSpecularMap", false);
@@ -196,6 +218,7 @@ void dg::StandardMaterial::SetSpecular(std::shared_ptr<Texture> specularMap) {
 }
 
 void dg::StandardMaterial::SetNormalMap(std::shared_ptr<Texture> normalMap) {
+  SetKeyword(Keyword::NORMAL_MAP, normalMap != nullptr);
 #if defined(_OPENGL)
   if (normalMap == nullptr) {
     SetProperty("_Material.useNormalMap", false);
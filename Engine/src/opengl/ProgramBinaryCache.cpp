@@ -0,0 +1,242 @@
+//
+//  opengl/ProgramBinaryCache.cpp
+//
+
+#include "dg/opengl/ProgramBinaryCache.h"
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include "dg/Utils.h"
+
+#define DG_GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define DG_GL_PROGRAM_BINARY_LENGTH 0x8741
+#define DG_GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+
+const std::string dg::ProgramBinaryCache::CacheDirectory = "shadercache";
+
+const uint32_t dg::ProgramBinaryCache::FileMagic = 0x44475042; // "DGPB"
+const uint32_t dg::ProgramBinaryCache::FileVersion = 1;
+
+bool dg::ProgramBinaryCache::initialized = false;
+bool dg::ProgramBinaryCache::supported = false;
+uint64_t dg::ProgramBinaryCache::driverKey = 0;
+dg::ProgramBinaryCache::GetProgramBinaryProc
+    dg::ProgramBinaryCache::getProgramBinary = nullptr;
+dg::ProgramBinaryCache::ProgramBinaryProc
+    dg::ProgramBinaryCache::programBinary = nullptr;
+dg::ProgramBinaryCache::ProgramParameteriProc
+    dg::ProgramBinaryCache::programParameteri = nullptr;
+dg::ProgramBinaryCache::Statistics dg::ProgramBinaryCache::statistics;
+
+namespace {
+
+  // FNV-1a. std::hash isn't guaranteed to be stable across runs, which the
+  // on-disk keys need to be.
+  const uint64_t FNVOffsetBasis = 0xcbf29ce484222325ULL;
+  const uint64_t FNVPrime = 0x100000001b3ULL;
+
+  uint64_t HashBytes(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++) {
+      hash ^= bytes[i];
+      hash *= FNVPrime;
+    }
+    return hash;
+  }
+
+  uint64_t HashString(uint64_t hash, const char *str) {
+    if (str == nullptr) {
+      return hash;
+    }
+    // Include the terminator so adjacent strings can't alias.
+    return HashBytes(hash, str, strlen(str) + 1);
+  }
+
+} // namespace
+
+bool dg::ProgramBinaryCache::IsSupported() {
+  Initialize();
+  return supported;
+}
+
+void dg::ProgramBinaryCache::Initialize() {
+  if (initialized) {
+    return;
+  }
+  initialized = true;
+
+  getProgramBinary =
+      (GetProgramBinaryProc)glfwGetProcAddress("glGetProgramBinary");
+  programBinary = (ProgramBinaryProc)glfwGetProcAddress("glProgramBinary");
+  programParameteri =
+      (ProgramParameteriProc)glfwGetProcAddress("glProgramParameteri");
+  if (getProgramBinary == nullptr || programBinary == nullptr ||
+      programParameteri == nullptr) {
+    return;
+  }
+
+  GLint formatCount = 0;
+  glGetIntegerv(DG_GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+  if (formatCount <= 0) {
+    return;
+  }
+
+  driverKey = FNVOffsetBasis;
+  driverKey = HashString(driverKey, (const char *)glGetString(GL_VENDOR));
+  driverKey = HashString(driverKey, (const char *)glGetString(GL_RENDERER));
+  driverKey = HashString(driverKey, (const char *)glGetString(GL_VERSION));
+
+  std::error_code error;
+  std::filesystem::create_directories(CacheDirectory, error);
+  supported = !error;
+}
+
+uint64_t dg::ProgramBinaryCache::KeyForSources(
+    const std::vector<std::shared_ptr<ShaderSource>> &sources) {
+  Initialize();
+  uint64_t key = driverKey;
+  for (auto &source : sources) {
+    GLenum type = source->GetType();
+    key = HashBytes(key, &type, sizeof(type));
+    key = HashString(key, source->GetContent().c_str());
+  }
+  return key;
+}
+
+std::string dg::ProgramBinaryCache::PathForKey(uint64_t key) {
+  std::ostringstream path;
+  path << CacheDirectory << PathSeparator() << std::hex << std::setw(16)
+       << std::setfill('0') << key << ".bin";
+  return path.str();
+}
+
+GLuint dg::ProgramBinaryCache::Load(uint64_t key) {
+  if (!IsSupported()) {
+    return 0;
+  }
+
+  auto startTime = std::chrono::high_resolution_clock::now();
+
+  std::ifstream file(PathForKey(key), std::ios::binary);
+  if (!file.is_open()) {
+    statistics.misses++;
+    return 0;
+  }
+
+  FileHeader header;
+  file.read((char *)&header, sizeof(header));
+  if (!file || header.magic != FileMagic || header.version != FileVersion ||
+      header.key != key || header.binaryLength == 0) {
+    statistics.misses++;
+    return 0;
+  }
+
+  std::vector<char> binary(header.binaryLength);
+  file.read(binary.data(), binary.size());
+  if (!file) {
+    statistics.misses++;
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  programBinary(program, (GLenum)header.binaryFormat, binary.data(),
+                (GLsizei)binary.size());
+  GLint success = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success) {
+    // The driver may reject binaries from a different driver build even if
+    // its version string didn't change. Discard it and recompile.
+    glDeleteProgram(program);
+    file.close();
+    std::remove(PathForKey(key).c_str());
+    statistics.rejected++;
+    statistics.misses++;
+    return 0;
+  }
+
+  std::chrono::duration<double> loadTime =
+      std::chrono::high_resolution_clock::now() - startTime;
+  statistics.hits++;
+  statistics.loadSeconds += loadTime.count();
+  statistics.savedCompileSeconds += header.compileSeconds;
+  return program;
+}
+
+void dg::ProgramBinaryCache::PrepareProgram(GLuint program) {
+  if (!IsSupported()) {
+    return;
+  }
+  programParameteri(program, DG_GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void dg::ProgramBinaryCache::Store(uint64_t key, GLuint program,
+                                   double compileSeconds) {
+  statistics.compileSeconds += compileSeconds;
+
+  if (!IsSupported()) {
+    return;
+  }
+
+  GLint length = 0;
+  glGetProgramiv(program, DG_GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+
+  std::vector<char> binary(length);
+  GLenum binaryFormat = 0;
+  GLsizei actualLength = 0;
+  getProgramBinary(program, length, &actualLength, &binaryFormat,
+                   binary.data());
+  if (actualLength <= 0) {
+    return;
+  }
+
+  FileHeader header;
+  header.magic = FileMagic;
+  header.version = FileVersion;
+  header.key = key;
+  header.binaryFormat = binaryFormat;
+  header.binaryLength = (uint32_t)actualLength;
+  header.compileSeconds = compileSeconds;
+
+  // Failing to write the cache isn't fatal; the program will just be compiled
+  // again next launch.
+  std::ofstream file(PathForKey(key), std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    return;
+  }
+  file.write((const char *)&header, sizeof(header));
+  file.write(binary.data(), actualLength);
+}
+
+void dg::ProgramBinaryCache::ReportStatistics(std::ostream &os) {
+  int total = statistics.hits + statistics.misses;
+  if (total == 0) {
+    return;
+  }
+
+  if (!IsSupported()) {
+    os << "Shader program cache: unsupported by driver, compiled " << total
+       << " programs in " << std::fixed << std::setprecision(1)
+       << statistics.compileSeconds * 1000 << " ms" << std::endl;
+    return;
+  }
+
+  os << "Shader program cache: " << statistics.hits << "/" << total
+     << " hits (" << std::fixed << std::setprecision(0)
+     << 100.0 * statistics.hits / total << "%)";
+  if (statistics.rejected > 0) {
+    os << ", " << statistics.rejected << " rejected";
+  }
+  os << std::setprecision(1) << ", loaded in "
+     << statistics.loadSeconds * 1000 << " ms, saved "
+     << (statistics.savedCompileSeconds - statistics.loadSeconds) * 1000
+     << " ms, compiled misses in " << statistics.compileSeconds * 1000
+     << " ms" << std::endl;
+}
@@ -8,10 +8,23 @@
 
 std::shared_ptr<dg::ShaderSource> dg::ShaderSource::FromFile(
     GLenum type, const std::string& path) {
+  auto source = Preprocess(type, path);
+  source->Compile();
+  return source;
+}
+
+std::shared_ptr<dg::ShaderSource> dg::ShaderSource::Preprocess(
+    GLenum type, const std::string& path) {
+  return Preprocess(type, path, {});
+}
+
+std::shared_ptr<dg::ShaderSource> dg::ShaderSource::Preprocess(
+    GLenum type, const std::string& path,
+    const std::vector<std::string>& defines) {
   auto source = std::shared_ptr<ShaderSource>(new ShaderSource());
   source->shaderType = type;
-  source->file = Preprocessor::ForFile(path);
-  source->CompileShader();
+  source->file = Preprocessor::ForFile(path, defines);
+  source->GetContent();
   return source;
 }
 
@@ -22,13 +35,17 @@ dg::ShaderSource::~ShaderSource() {
   }
 }
 
-void dg::ShaderSource::CompileShader() {
+void dg::ShaderSource::Compile() {
+  BeginCompile();
+  CheckCompileErrors();
+}
+
+void dg::ShaderSource::BeginCompile() {
   assert(shaderHandle == 0);
   shaderHandle = glCreateShader(shaderType);
   const char *code = GetContent().c_str();
   glShaderSource(shaderHandle, 1, &code, NULL);
   glCompileShader(shaderHandle);
-  CheckCompileErrors();
 }
 
 void dg::ShaderSource::CheckCompileErrors() {
@@ -24,7 +24,7 @@ void dg::VRControllerState::Initialize() {
 
 void dg::VRControllerState::Start() {
   Behavior::Start();
-  trackedObject = GetSceneObject()->GetBehavior<VRTrackedObject>();
+  trackedObject = GetSceneObject()->GetBehaviorPointer<VRTrackedObject>();
 }
 
 void dg::VRControllerState::Update() {
@@ -33,7 +33,6 @@ void dg::VRControllerState::Update() {
   buttonWasPressed = buttonPressed;
   buttonWasTouched = buttonTouched;
 
-  auto trackedObject = this->trackedObject.lock();
   if (!trackedObject || !trackedObject->enabled) {
     ResetState();
     return;
@@ -13,13 +13,12 @@
 
 void dg::VRRenderModel::Start() {
   Behavior::Start();
-  trackedObject = GetSceneObject()->GetBehavior<VRTrackedObject>();
+  trackedObject = GetSceneObject()->GetBehaviorPointer<VRTrackedObject>();
 }
 
 void dg::VRRenderModel::Update() {
   Behavior::Update();
 
-  auto trackedObject = this->trackedObject.lock();
   if (!trackedObject) {
     return;
   }
@@ -75,14 +75,26 @@ vec3 calculateLight(
 
   // Calculate shadow
   float shadow = 0;
-  if (light.hasShadow == 1) {
+  if (light.hasShadow == SHADOW_ATLAS) {
     vec4 fragPosLightSpace = light.lightTransform * vec4(position, 1);
     vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
     projCoords = projCoords * 0.5 + 0.5;
-    float closestDepth = texture(_ShadowMap, projCoords.xy).r;
-    float currentDepth = projCoords.z;
-    float bias = 0.0001;
-    shadow = currentDepth - bias > closestDepth  ? 1.0 : 0.0;
+
+    // The light's shadow is one tile of a shared shadow atlas. Fragments
+    // outside of the light's view are unshadowed, and samples are kept half
+    // a texel inside the tile so as not to filter in its neighbors.
+    if (all(greaterThanEqual(projCoords, vec3(0))) &&
+        all(lessThanEqual(projCoords, vec3(1)))) {
+      vec2 halfTexel = 0.5 / vec2(textureSize(_ShadowMap, 0));
+      vec2 atlasCoords = clamp(
+          light.shadowRect.xy + projCoords.xy * light.shadowRect.zw,
+          light.shadowRect.xy + halfTexel,
+          light.shadowRect.xy + light.shadowRect.zw - halfTexel);
+      float closestDepth = texture(_ShadowMap, atlasCoords).r;
+      float currentDepth = projCoords.z;
+      float bias = 0.0001;
+      shadow = currentDepth - bias > closestDepth  ? 1.0 : 0.0;
+    }
   }
 
 	return ((1.0 - shadow) * (specular + diffuse)) + ambient;
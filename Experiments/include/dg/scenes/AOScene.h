@@ -48,15 +48,17 @@ namespace dg {
 
       void InitializeDeferred();
       void InitializeSSAO();
-      void CreateGBuffer();
-      void CreateSSAOBuffers();
+      FrameBuffer::Options GBufferOptions() const;
+      FrameBuffer::Options SSAOOptions() const;
 
       void LinkGeometryToSSAO();
       void LinkGeometryToLight();
       void LinkSSAOToLight();
+      void LinkOverlays();
 
-      virtual void RenderFramebuffers();
+      virtual void AddRenderPasses(RenderGraph &graph);
       virtual void PreRender();
+      virtual void PreSubrender(const Subrender &subrender);
 
       OverlayState overlayState = OverlayState::GBuffer;
 
@@ -20,6 +20,7 @@ namespace dg {
 
       virtual void Initialize();
       virtual void Update();
+      virtual bool AllowsPipelinedUpdate() const;
 
     private:
 
@@ -30,6 +30,10 @@ namespace dg {
       std::shared_ptr<Model> cube = nullptr;
       std::shared_ptr<SpotLight> spotlight = nullptr;
       std::shared_ptr<ScreenQuadMaterial> quadMaterial = nullptr;
+      // The light stays still unless toggled, so that its static shadows
+      // are cached.
+      bool orbitingLight = false;
+      double lastCacheReportTime = 0;
 
   }; // class ShadowScene
 
@@ -137,10 +137,7 @@ void dg::AOScene::Initialize() {
   // Don't render overlays in the shadowmap.
   subrenders.light.layerMask = LayerMask::ALL() - LayerMask::Overlay();
 
-  CreateSSAOBuffers();
   InitializeSSAO();
-
-  CreateGBuffer();
   InitializeDeferred();
 }
 
@@ -268,59 +265,61 @@ void dg::AOScene::Update() {
                               ((1.f - 2 * i) / 3.f) + quadScale.y * 0.5));
   }
 
-  // Update overlay quad textures based on overlay state.
+  // Enable overlay quads based on overlay state. Their textures are set once
+  // this frame's framebuffers are known, in LinkOverlays().
   switch (overlayState) {
     case OverlayState::None:
       break;
-    case OverlayState::GBuffer: {
+    case OverlayState::GBuffer:
       overlayQuads[0]->enabled = true;
-      std::static_pointer_cast<ScreenQuadMaterial>(overlayQuads[0]->material)
-          ->SetTexture(geometrySubrender.framebuffer->GetColorTexture(0));
       overlayQuads[1]->enabled = true;
-      std::static_pointer_cast<ScreenQuadMaterial>(overlayQuads[1]->material)
-          ->SetTexture(geometrySubrender.framebuffer->GetColorTexture(1));
       overlayQuads[2]->enabled = true;
-      std::static_pointer_cast<ScreenQuadMaterial>(overlayQuads[2]->material)
-          ->SetTexture(geometrySubrender.framebuffer->GetColorTexture(2));
       break;
-    };
-    case OverlayState::Lighting: {
+    case OverlayState::Lighting:
       overlayQuads[0]->enabled = true;
-      std::static_pointer_cast<ScreenQuadMaterial>(overlayQuads[0]->material)
-          ->SetTexture(subrenders.light.framebuffer->GetColorTexture());
       overlayQuads[1]->enabled = true;
-      std::static_pointer_cast<ScreenQuadMaterial>(overlayQuads[1]->material)
-          ->SetTexture(subrenders.light.framebuffer->GetDepthTexture());
       std::static_pointer_cast<ScreenQuadMaterial>(overlayQuads[1]->material)
           ->SetRedChannelOnly(true);
       break;
-    };
-    case OverlayState::SSAO: {
+    case OverlayState::SSAO:
       overlayQuads[0]->enabled = true;
-      std::static_pointer_cast<ScreenQuadMaterial>(overlayQuads[0]->material)
-          ->SetTexture(ssaoSubrender.framebuffer->GetColorTexture());
       break;
-    };
   }
 }
 
-void dg::AOScene::RenderFramebuffers() {
-  // Create or resize framebuffers if needed.
-  glm::vec2 windowSize = window->GetFramebufferSize();
-  if (geometrySubrender.framebuffer == nullptr ||
-      geometrySubrender.framebuffer->GetWidth() != windowSize.x ||
-      geometrySubrender.framebuffer->GetHeight() != windowSize.y) {
-    CreateGBuffer();
-    CreateSSAOBuffers();
-  }
-
-  PerformSubrender(geometrySubrender);
-  if (enableSSAO) {
-    PerformSubrender(ssaoSubrender);
+void dg::AOScene::AddRenderPasses(RenderGraph &graph) {
+  RenderGraph::Resource gbuffer =
+      graph.CreateFrameBuffer("GBuffer", GBufferOptions());
+  graph.AddPass(
+      "Geometry",
+      [gbuffer](RenderGraph::PassBuilder &builder) { builder.Write(gbuffer); },
+      [this, gbuffer](RenderGraph &graph) {
+        geometrySubrender.framebuffer = graph.GetFrameBuffer(gbuffer);
+        LinkGeometryToLight();
+        LinkGeometryToSSAO();
+        PerformSubrender(geometrySubrender);
+      });
+  currentRender.mainPassInputs.push_back(gbuffer);
+
+  // The SSAO pass is culled unless the lighting pass or the overlay uses it.
+  RenderGraph::Resource ssao = graph.CreateFrameBuffer("SSAO", SSAOOptions());
+  graph.AddPass(
+      "SSAO",
+      [gbuffer, ssao](RenderGraph::PassBuilder &builder) {
+        builder.Read(gbuffer);
+        builder.Write(ssao);
+      },
+      [this, ssao](RenderGraph &graph) {
+        ssaoSubrender.framebuffer = graph.GetFrameBuffer(ssao);
+        LinkSSAOToLight();
+        PerformSubrender(ssaoSubrender);
+      });
+  if (enableSSAO || overlayState == OverlayState::SSAO) {
+    currentRender.mainPassInputs.push_back(ssao);
   }
 }
 
-void dg::AOScene::CreateGBuffer() {
+dg::FrameBuffer::Options dg::AOScene::GBufferOptions() const {
   glm::vec2 windowSize = window->GetFramebufferSize();
 
   FrameBuffer::Options opts;
@@ -362,14 +361,10 @@ void dg::AOScene::CreateGBuffer() {
   opts.textureOptions[4].pixelType = TexturePixelType::FLOAT;
   opts.textureOptions[4].wrap = TextureWrap::CLAMP_EDGE;
 
-  geometrySubrender.framebuffer = FrameBuffer::Create(opts);
-
-  LinkGeometryToLight();
-  LinkGeometryToSSAO();
-  LinkSSAOToLight();
+  return opts;
 }
 
-void dg::AOScene::CreateSSAOBuffers() {
+dg::FrameBuffer::Options dg::AOScene::SSAOOptions() const {
   glm::vec2 windowSize = window->GetFramebufferSize();
 
   const float ssaoScale = 1.f / 3;
@@ -385,10 +380,36 @@ void dg::AOScene::CreateSSAOBuffers() {
   opts.textureOptions[0].pixelType = TexturePixelType::FLOAT;
   opts.textureOptions[0].interpolation = TextureInterpolation::NEAREST;
   opts.textureOptions[0].wrap = TextureWrap::CLAMP_EDGE;
-  ssaoSubrender.framebuffer = FrameBuffer::Create(opts);
+  return opts;
+}
 
-  LinkGeometryToSSAO();
-  LinkSSAOToLight();
+void dg::AOScene::LinkOverlays() {
+  // Point overlay quads at this frame's framebuffers.
+  switch (overlayState) {
+    case OverlayState::None:
+      break;
+    case OverlayState::GBuffer: {
+      std::static_pointer_cast<ScreenQuadMaterial>(overlayQuads[0]->material)
+          ->SetTexture(geometrySubrender.framebuffer->GetColorTexture(0));
+      std::static_pointer_cast<ScreenQuadMaterial>(overlayQuads[1]->material)
+          ->SetTexture(geometrySubrender.framebuffer->GetColorTexture(1));
+      std::static_pointer_cast<ScreenQuadMaterial>(overlayQuads[2]->material)
+          ->SetTexture(geometrySubrender.framebuffer->GetColorTexture(2));
+      break;
+    };
+    case OverlayState::Lighting: {
+      std::static_pointer_cast<ScreenQuadMaterial>(overlayQuads[0]->material)
+          ->SetTexture(subrenders.light.framebuffer->GetColorTexture());
+      std::static_pointer_cast<ScreenQuadMaterial>(overlayQuads[1]->material)
+          ->SetTexture(subrenders.light.framebuffer->GetDepthTexture());
+      break;
+    };
+    case OverlayState::SSAO: {
+      std::static_pointer_cast<ScreenQuadMaterial>(overlayQuads[0]->material)
+          ->SetTexture(ssaoSubrender.framebuffer->GetColorTexture());
+      break;
+    };
+  }
 }
 
 void dg::AOScene::LinkGeometryToSSAO() {
@@ -443,3 +464,9 @@ void dg::AOScene::PreRender() {
   // into view space.
   ssaoSubrender.camera = subrenders.main.camera;
 }
+
+void dg::AOScene::PreSubrender(const Subrender &subrender) {
+  if (&subrender == &subrenders.main) {
+    LinkOverlays();
+  }
+}
@@ -145,6 +145,7 @@ void dg::CubemapScene::Initialize() {
   FrameBuffer::Options fbOpts;
   fbOpts.width = fbSize;
   fbOpts.height = fbSize;
+  fbOpts.type = TextureType::CUBEMAP;
   fbOpts.textureOptions.push_back(reflectionTexOpts);
   reflectionSubrender.framebuffer = FrameBuffer::Create(fbOpts);
 
@@ -200,3 +200,9 @@ void dg::MeshesScene::Update() {
   spinningTorus->transform.rotation = glm::quat(glm::radians(
         glm::vec3(0, dg::Time::Elapsed * 10, 0)));
 }
+
+bool dg::MeshesScene::AllowsPipelinedUpdate() const {
+  // Update() only moves models and the camera. In VR, tracked poses are
+  // updated during rendering, so the update can't overlap it.
+  return !vr.enabled;
+}
@@ -5,6 +5,7 @@
 #include "dg/scenes/ShadowScene.h"
 #include <forward_list>
 #include <glm/glm.hpp>
+#include <iostream>
 #include "dg/Camera.h"
 #include "dg/EngineTime.h"
 #include "dg/FrameBuffer.h"
@@ -74,6 +75,7 @@ void dg::ShadowScene::Initialize() {
   cube = std::make_shared<Model>(
       dg::Mesh::Cube, std::make_shared<StandardMaterial>(cubeMaterial),
       Transform::TS(glm::vec3(0, 0.25f, 0), glm::vec3(0.5f)));
+  cube->isStatic = true;
   AddChild(cube);
 
   // Create floor material.
@@ -83,10 +85,12 @@ void dg::ShadowScene::Initialize() {
   floorMaterial.SetUVScale(glm::vec2((float)floorSize));
 
   // Create floor plane.
-  AddChild(std::make_shared<Model>(
+  auto floorModel = std::make_shared<Model>(
       dg::Mesh::Quad, std::make_shared<StandardMaterial>(floorMaterial),
       Transform::RS(glm::quat(glm::radians(glm::vec3(-90, 0, 0))),
-                    glm::vec3(floorSize, floorSize, 1))));
+                    glm::vec3(floorSize, floorSize, 1)));
+  floorModel->isStatic = true;
+  AddChild(floorModel);
 
   // Configure camera.
   cameras.main->transform = Transform::T({1.054, 1.467, 2.048});
@@ -113,10 +117,28 @@ void dg::ShadowScene::Initialize() {
 void dg::ShadowScene::Update() {
   Scene::Update();
 
-  // Slowly rotate light.
-  spotlight->transform =
-      Transform::R(glm::quat(glm::radians(glm::vec3(0, Time::Delta * 30, 0)))) *
-      spotlight->transform;
+  // Toggle orbiting the light with keyboard tap of L.
+  if (window->IsKeyJustPressed(Key::L)) {
+    orbitingLight = !orbitingLight;
+  }
+
+  // Slowly rotate light. Moving it redraws its cached static shadows every
+  // frame.
+  if (orbitingLight) {
+    spotlight->transform =
+        Transform::R(
+            glm::quat(glm::radians(glm::vec3(0, Time::Delta * 30, 0)))) *
+        spotlight->transform;
+  }
+
+  // Report how often the static shadow cache was hit every few seconds.
+  const double cacheReportInterval = 5;
+  if (Time::Elapsed >= lastCacheReportTime + cacheReportInterval) {
+    std::cout << "Static shadow tiles:"
+              << "\t" << shadowCache.reusedTiles << " reused"
+              << "\t" << shadowCache.redrawnTiles << " redrawn" << std::endl;
+    lastCacheReportTime = Time::Elapsed;
+  }
 }
 
 void dg::ShadowScene::PostProcess() {
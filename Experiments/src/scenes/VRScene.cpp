@@ -262,8 +262,8 @@ void dg::VRScene::Update() {
   Scene::Update();
 
   // Get VR controller states.
-  auto leftState = leftController->GetBehavior<VRControllerState>();
-  auto rightState = rightController->GetBehavior<VRControllerState>();
+  auto leftState = leftController->GetBehaviorPointer<VRControllerState>();
+  auto rightState = rightController->GetBehaviorPointer<VRControllerState>();
 
   // Vary flashlight brightness based on trigger squeeze amount.
   const float minLighting = 0.3f;